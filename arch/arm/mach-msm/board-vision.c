@@ -3171,6 +3171,29 @@ static struct platform_device *devices[] __initdata = {
 	//	&cable_detect_device,
 };
 
+/*
+ * SDCC (eMMC, SD card, wifi) and the i2c buses carrying touch and the
+ * sensors dominate resume time and don't depend on each other, so let
+ * them suspend and resume in parallel.  The SDCC driver moves data with
+ * the data mover, which must be up first.
+ */
+static struct platform_device *vision_async_devices[] __initdata = {
+	&msm_device_sdc1,
+	&msm_device_sdc2,
+	&msm_device_sdc3,
+	&msm_device_sdc4,
+	&msm_device_i2c,
+	&msm_device_i2c_2,
+	&qup_device_i2c,
+};
+
+static struct msm_pm_async_dep vision_async_deps[] __initdata = {
+	{ &msm_device_sdc1, &msm_device_dmov },
+	{ &msm_device_sdc2, &msm_device_dmov },
+	{ &msm_device_sdc3, &msm_device_dmov },
+	{ &msm_device_sdc4, &msm_device_dmov },
+};
+
 static void __init vision_init(void)
 {
 	int rc = 0;
@@ -3315,6 +3338,10 @@ static void __init vision_init(void)
 	vision_audio_init();
 	vision_wifi_init();
 	msm_init_pmic_vibrator(3000);
+
+	msm_pm_async_init(vision_async_devices,
+			  ARRAY_SIZE(vision_async_devices),
+			  vision_async_deps, ARRAY_SIZE(vision_async_deps));
 }
 
 static unsigned pmem_sf_size = MSM_PMEM_SF_SIZE;
@@ -20,6 +20,8 @@
 #define __ARCH_ARM_MACH_PERF_LOCK_H
 
 #include <linux/list.h>
+#include <linux/ktime.h>
+#include <linux/pm_qos.h>
 
 /*
  * Performance level determine differnt EBI1 rate
@@ -44,12 +46,21 @@ enum {
 	CEILING_LEVEL_INVALID,
 };
 
+/*
+ * An active perf lock holds a PM_QOS_CPU_FREQ_MIN request, an active
+ * cpufreq ceiling lock a PM_QOS_CPU_FREQ_MAX request.  The residency
+ * fields are reported through debugfs.
+ */
 struct perf_lock {
 	struct list_head link;
 	unsigned int flags;
 	unsigned int level;
 	const char *name;
 	unsigned int type;
+	struct pm_qos_request_list qos;
+	ktime_t active_since;
+	ktime_t total_time;
+	unsigned long count;
 };
 
 struct perflock_platform_data {
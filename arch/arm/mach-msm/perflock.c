@@ -22,6 +22,9 @@
 #include <linux/earlysuspend.h>
 #include <linux/cpufreq.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/seq_file.h>
+#include <linux/pm_qos.h>
 #include <mach/perflock.h>
 #include "proc_comm.h"
 #include "acpuclock.h"
@@ -37,14 +40,20 @@ enum {
 	PERF_SCREEN_ON_POLICY_DEBUG = 1U << 4,
 };
 
-static LIST_HEAD(active_perf_locks);
-static LIST_HEAD(inactive_perf_locks);
-static LIST_HEAD(active_cpufreq_ceiling_locks);
-static LIST_HEAD(inactive_cpufreq_ceiling_locks);
+/*
+ * Active locks are PM QoS requests, so the aggregate floor and ceiling
+ * are read from the plist heads in O(1).  perf_locks only links every
+ * initialized lock for the debug output and the residency statistics.
+ */
+static LIST_HEAD(perf_locks);
 static DEFINE_SPINLOCK(list_lock);
 static DEFINE_SPINLOCK(policy_update_lock);
+static int active_perf_lock_count;
 static int initialized;
 static int cpufreq_ceiling_initialized;
+static int notifiers_registered;
+static s32 last_qos_floor = PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE;
+static s32 last_qos_ceiling = PM_QOS_CPU_FREQ_MAX_DEFAULT_VALUE;
 static unsigned int *perf_acpu_table;
 static unsigned int *cpufreq_ceiling_acpu_table;
 static unsigned int table_size;
@@ -65,8 +74,6 @@ static struct kernel_param_ops param_ops_str = {
 
 module_param_cb(debug_mask, &param_ops_str, &debug_mask, S_IWUSR | S_IRUGO);
 
-static unsigned int get_perflock_speed(void);
-static unsigned int get_cpufreq_ceiling_speed(void);
 static void print_active_locks(void);
 
 #ifdef CONFIG_PERFLOCK_SCREEN_POLICY
@@ -111,7 +118,7 @@ static void perflock_late_resume(struct early_suspend *handler)
 	/* Work around for display driver,
 	 * need to increase cpu speed immediately.
 	 */
-	unsigned int lock_speed = get_perflock_speed() / 1000;
+	unsigned int lock_speed = pm_qos_request(PM_QOS_CPU_FREQ_MIN);
 	if (lock_speed > CONFIG_PERFLOCK_SCREEN_ON_MIN)
 		acpuclk_set_rate(lock_speed * 1000, 0);
 	else
@@ -182,8 +189,7 @@ static int perflock_notifier_call(struct notifier_block *self,
 			       unsigned long event, void *data)
 {
 	struct cpufreq_policy *policy = data;
-	unsigned int lock_speed = 0;
-	unsigned int cpufreq_ceiling_speed = 0;
+	unsigned int floor, ceiling;
 	unsigned long irqflags;
 	unsigned int policy_min = per_cpu(stored_policy_min, policy->cpu);
 	unsigned int policy_max = per_cpu(stored_policy_max, policy->cpu);
@@ -217,36 +223,26 @@ static int perflock_notifier_call(struct notifier_block *self,
 			screen_off_policy_req--;
 		}
 #endif
-		lock_speed = get_perflock_speed() / 1000;
-		if (!lock_speed)
-			cpufreq_ceiling_speed = get_cpufreq_ceiling_speed() / 1000;
-
-		if (lock_speed) {
-			if (lock_speed > policy_max)
-				lock_speed = policy_max;
-			policy->min = lock_speed;
-			policy->max = lock_speed;
-			if (debug_mask & PERF_CPUFREQ_LOCK_DEBUG) {
-				pr_info("%s: cpufreq lock speed %d\n",
-					__func__, lock_speed);
-				print_active_locks();
-			}
-		} else if (cpufreq_ceiling_speed) {
-			if (cpufreq_ceiling_speed > policy_max)
-				cpufreq_ceiling_speed = policy_max;
-			policy->max = cpufreq_ceiling_speed;
-			policy->min = policy_min;
-			if (debug_mask & PERF_CPUFREQ_LOCK_DEBUG) {
-				pr_info("%s: cpufreq_ceiling speed %d\n",
-					__func__, cpufreq_ceiling_speed);
-				print_active_locks();
-			}
-		} else {
-			policy->max = policy_max;
-			policy->min = policy_min;
-			if (debug_mask & PERF_CPUFREQ_LOCK_DEBUG)
-				pr_info("%s: cpufreq recover policy %d %d\n"
-						, __func__, policy->min, policy->max);
+		floor = pm_qos_request(PM_QOS_CPU_FREQ_MIN);
+		ceiling = pm_qos_request(PM_QOS_CPU_FREQ_MAX);
+
+		/* A floor is capped by the user's max but beats a ceiling. */
+		if (floor > policy_max)
+			floor = policy_max;
+		if (ceiling < policy_max)
+			policy_max = ceiling;
+		if (floor > policy_min)
+			policy_min = floor;
+		if (policy_min > policy_max)
+			policy_max = policy_min;
+
+		policy->min = policy_min;
+		policy->max = policy_max;
+		if (debug_mask & PERF_CPUFREQ_LOCK_DEBUG) {
+			pr_info("%s: cpufreq floor %u ceiling %u policy %d %d\n",
+				__func__, floor, ceiling,
+				policy->min, policy->max);
+			print_active_locks();
 		}
 	}
 	spin_unlock_irqrestore(&policy_update_lock, irqflags);
@@ -272,82 +268,49 @@ static struct notifier_block perflock_notifier = {
 	.notifier_call = perflock_notifier_call,
 };
 
-static unsigned int get_perflock_speed(void)
-{
-	unsigned long irqflags;
-	struct perf_lock *lock;
-	unsigned int perf_level = 0;
-
-	/* Get the maxmimum perf level. */
-	if (list_empty(&active_perf_locks))
-		return 0;
-
-	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_perf_locks, link) {
-		if (lock->level > perf_level)
-			perf_level = lock->level;
-	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
-
-	return perf_acpu_table[perf_level];
-}
-
-static unsigned int get_cpufreq_ceiling_speed(void)
+static void print_active_locks(void)
 {
 	unsigned long irqflags;
 	struct perf_lock *lock;
-	unsigned int perf_level = 0;
-
-	/* Get the maxmimum perf level. */
-	if (list_empty(&active_cpufreq_ceiling_locks))
-		return 0;
 
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_cpufreq_ceiling_locks, link) {
-		if (lock->level > perf_level)
-			perf_level = lock->level;
+	list_for_each_entry(lock, &perf_locks, link) {
+		if (!(lock->flags & PERF_LOCK_ACTIVE))
+			continue;
+		if (lock->type == TYPE_PERF_LOCK)
+			pr_info("active perf lock '%s'\n", lock->name);
+		else
+			pr_info("active cpufreq_ceiling_locks '%s'\n",
+				lock->name);
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
-
-	return cpufreq_ceiling_acpu_table[perf_level];
 }
 
-static void print_active_locks(void)
+void htc_print_active_perf_locks(void)
 {
 	unsigned long irqflags;
 	struct perf_lock *lock;
 
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_perf_locks, link) {
-		pr_info("active perf lock '%s'\n", lock->name);
-	}
-	list_for_each_entry(lock, &active_cpufreq_ceiling_locks, link) {
-		pr_info("active cpufreq_ceiling_locks '%s'\n", lock->name);
+	list_for_each_entry(lock, &perf_locks, link) {
+		if (!(lock->flags & PERF_LOCK_ACTIVE))
+			continue;
+		if (lock->type == TYPE_PERF_LOCK)
+			pr_info("perf_lock: '%s'\n", lock->name);
+		else
+			printk(KERN_WARNING "perf_lock: '%s' (ceiling)\n",
+			       lock->name);
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 
-void htc_print_active_perf_locks(void)
+static void perflock_update_policy(void)
 {
-	unsigned long irqflags;
-	struct perf_lock *lock;
+	int cpu;
 
-	spin_lock_irqsave(&list_lock, irqflags);
-	if (!list_empty(&active_perf_locks)) {
-		pr_info("perf_lock:");
-		list_for_each_entry(lock, &active_perf_locks, link) {
-			pr_info(" '%s' ", lock->name);
-		}
-		pr_info("\n");
-	}
-	if (!list_empty(&active_cpufreq_ceiling_locks)) {
-		printk(KERN_WARNING"perf_lock:");
-		list_for_each_entry(lock, &active_cpufreq_ceiling_locks, link) {
-			printk(KERN_WARNING" '%s' ", lock->name);
-		}
-		pr_info("\n");
+	for_each_online_cpu(cpu) {
+		cpufreq_update_policy(cpu);
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 
 void perf_lock_init_v2(struct perf_lock *lock,
@@ -382,13 +345,13 @@ void perf_lock_init(struct perf_lock *lock,
 	lock->name = name;
 	lock->flags = PERF_LOCK_INITIALIZED;
 	lock->level = level;
+	memset(&lock->qos, 0, sizeof(lock->qos));
+	lock->total_time = ktime_set(0, 0);
+	lock->count = 0;
 
 	INIT_LIST_HEAD(&lock->link);
 	spin_lock_irqsave(&list_lock, irqflags);
-	if (lock->type == TYPE_PERF_LOCK)
-		list_add(&lock->link, &inactive_perf_locks);
-	if (lock->type == TYPE_CPUFREQ_CEILING)
-		list_add(&lock->link, &inactive_cpufreq_ceiling_locks);
+	list_add(&lock->link, &perf_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(perf_lock_init);
@@ -402,7 +365,6 @@ EXPORT_SYMBOL(perf_lock_init);
 void perf_lock(struct perf_lock *lock)
 {
 	unsigned long irqflags;
-	int cpu;
 
 	WARN_ON((lock->flags & PERF_LOCK_INITIALIZED) == 0);
 	WARN_ON(lock->flags & PERF_LOCK_ACTIVE);
@@ -432,17 +394,19 @@ void perf_lock(struct perf_lock *lock)
 		return;
 	}
 	lock->flags |= PERF_LOCK_ACTIVE;
-	list_del(&lock->link);
+	lock->active_since = ktime_get();
+	lock->count++;
 	if (lock->type == TYPE_PERF_LOCK)
-		list_add(&lock->link, &active_perf_locks);
-	else if (lock->type == TYPE_CPUFREQ_CEILING)
-		list_add(&lock->link, &active_cpufreq_ceiling_locks);
+		active_perf_lock_count++;
 	spin_unlock_irqrestore(&list_lock, irqflags);
 
-	/* Update cpufreq policy - scaling_min/scaling_max */
-	for_each_online_cpu(cpu) {
-		cpufreq_update_policy(cpu);
-	}
+	/* perflock_qos_notify() updates scaling_min/scaling_max */
+	if (lock->type == TYPE_PERF_LOCK)
+		pm_qos_add_request(&lock->qos, PM_QOS_CPU_FREQ_MIN,
+				   perf_acpu_table[lock->level] / 1000);
+	else
+		pm_qos_add_request(&lock->qos, PM_QOS_CPU_FREQ_MAX,
+				   cpufreq_ceiling_acpu_table[lock->level] / 1000);
 }
 EXPORT_SYMBOL(perf_lock);
 
@@ -471,6 +435,11 @@ static void do_expire_perf_locks(struct work_struct *work)
 	if (debug_mask & PERF_EXPIRE_DEBUG)
 		pr_info("%s: timed out to unlock\n", __func__);
 
+	spin_lock_irq(&policy_update_lock);
+	last_qos_floor = pm_qos_request(PM_QOS_CPU_FREQ_MIN);
+	last_qos_ceiling = pm_qos_request(PM_QOS_CPU_FREQ_MAX);
+	spin_unlock_irq(&policy_update_lock);
+
 	for_each_online_cpu(cpu) {
 		ret = perflock_cpufreq_update_policy(cpu);
 		if (debug_mask & PERF_EXPIRE_DEBUG)
@@ -480,6 +449,60 @@ static void do_expire_perf_locks(struct work_struct *work)
 }
 static DECLARE_DELAYED_WORK(work_expire_perf_locks, do_expire_perf_locks);
 
+/*
+ * A raised floor or a lowered ceiling takes effect at once.  Relaxing
+ * either is delayed by PERF_UNLOCK_DELAY so that quick lock/unlock
+ * sequences don't bounce the policy.
+ */
+static int perflock_qos_notify(struct notifier_block *nb,
+			       unsigned long value, void *data)
+{
+	int pm_qos_class = (long)data;
+	unsigned long irqflags;
+	int tighten;
+
+	spin_lock_irqsave(&policy_update_lock, irqflags);
+	if (pm_qos_class == PM_QOS_CPU_FREQ_MIN) {
+		tighten = (s32)value > last_qos_floor;
+		if (tighten)
+			last_qos_floor = value;
+	} else {
+		tighten = (s32)value < last_qos_ceiling;
+		if (tighten)
+			last_qos_ceiling = value;
+	}
+	spin_unlock_irqrestore(&policy_update_lock, irqflags);
+
+	if (tighten) {
+		perflock_update_policy();
+	} else {
+		/* Prevent lock/unlock quickly, add a timeout to release */
+		queue_delayed_work(perflock_workqueue, &work_expire_perf_locks,
+				   PERF_UNLOCK_DELAY);
+	}
+	return NOTIFY_OK;
+}
+
+static int perflock_qos_min_notify(struct notifier_block *nb,
+				   unsigned long value, void *data)
+{
+	return perflock_qos_notify(nb, value, (void *)PM_QOS_CPU_FREQ_MIN);
+}
+
+static int perflock_qos_max_notify(struct notifier_block *nb,
+				   unsigned long value, void *data)
+{
+	return perflock_qos_notify(nb, value, (void *)PM_QOS_CPU_FREQ_MAX);
+}
+
+static struct notifier_block perflock_qos_min_nb = {
+	.notifier_call = perflock_qos_min_notify,
+};
+
+static struct notifier_block perflock_qos_max_nb = {
+	.notifier_call = perflock_qos_max_notify,
+};
+
 /**
  * perf_unlock - de-activate a perf lock
  * @lock: perf lock to de-activate
@@ -519,18 +542,14 @@ void perf_unlock(struct perf_lock *lock)
 		return;
 	}
 	lock->flags &= ~PERF_LOCK_ACTIVE;
-	list_del(&lock->link);
+	lock->total_time = ktime_add(lock->total_time,
+			ktime_sub(ktime_get(), lock->active_since));
 	if (lock->type == TYPE_PERF_LOCK)
-		list_add(&lock->link, &inactive_perf_locks);
-	else if (lock->type == TYPE_CPUFREQ_CEILING)
-		list_add(&lock->link, &inactive_cpufreq_ceiling_locks);
-
+		active_perf_lock_count--;
 	spin_unlock_irqrestore(&list_lock, irqflags);
 
-	/* Prevent lock/unlock quickly, add a timeout to release perf_lock */
-	queue_delayed_work(perflock_workqueue, &work_expire_perf_locks,
-			PERF_UNLOCK_DELAY);
-
+	/* The policy is relaxed by perflock_qos_notify() after a delay */
+	pm_qos_remove_request(&lock->qos);
 }
 EXPORT_SYMBOL(perf_unlock);
 
@@ -553,10 +572,75 @@ EXPORT_SYMBOL(is_perf_lock_active);
  */
 int is_perf_locked(void)
 {
-	return (!list_empty(&active_perf_locks));
+	return active_perf_lock_count != 0;
 }
 EXPORT_SYMBOL(is_perf_locked);
 
+#ifdef CONFIG_DEBUG_FS
+static int perflock_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned long irqflags;
+	struct perf_lock *lock;
+	ktime_t now = ktime_get();
+	ktime_t total;
+
+	seq_printf(m, "floor %d ceiling %d\n",
+		   pm_qos_request(PM_QOS_CPU_FREQ_MIN),
+		   pm_qos_request(PM_QOS_CPU_FREQ_MAX));
+	seq_printf(m, "%-24s %-7s %5s %6s %8s %12s\n",
+		   "name", "type", "level", "active", "count", "total_ms");
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	list_for_each_entry(lock, &perf_locks, link) {
+		total = lock->total_time;
+		if (lock->flags & PERF_LOCK_ACTIVE)
+			total = ktime_add(total,
+					  ktime_sub(now, lock->active_since));
+		seq_printf(m, "%-24s %-7s %5u %6d %8lu %12lld\n",
+			   lock->name,
+			   lock->type == TYPE_PERF_LOCK ? "perf" : "ceiling",
+			   lock->level, !!(lock->flags & PERF_LOCK_ACTIVE),
+			   lock->count, ktime_to_ms(total));
+	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	return 0;
+}
+
+static int perflock_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, perflock_stats_show, NULL);
+}
+
+static const struct file_operations perflock_stats_fops = {
+	.open		= perflock_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init perflock_debugfs_init(void)
+{
+	debugfs_create_file("perflock", S_IRUGO, NULL, NULL,
+			    &perflock_stats_fops);
+	return 0;
+}
+late_initcall(perflock_debugfs_init);
+#endif
+
+/* Shared by perflock_init() and cpufreq_ceiling_init(). */
+static void __init perflock_register_notifiers(void)
+{
+	if (notifiers_registered)
+		return;
+
+	perflock_workqueue = create_singlethread_workqueue("perflock_wq");
+	cpufreq_register_notifier(&perflock_notifier, CPUFREQ_POLICY_NOTIFIER);
+	pm_qos_add_notifier(PM_QOS_CPU_FREQ_MIN, &perflock_qos_min_nb);
+	pm_qos_add_notifier(PM_QOS_CPU_FREQ_MAX, &perflock_qos_max_nb);
+	notifiers_registered = 1;
+}
+
 
 #ifdef CONFIG_PERFLOCK_BOOT_LOCK
 /* Stop cpufreq and lock cpu, shorten boot time. */
@@ -640,8 +724,7 @@ void __init perflock_init(struct perflock_platform_data *pdata)
 		goto invalid_config;
 
 	perf_acpu_table_fixup();
-	cpufreq_register_notifier(&perflock_notifier, CPUFREQ_POLICY_NOTIFIER);
-	perflock_workqueue = create_singlethread_workqueue("perflock_wq");
+	perflock_register_notifiers();
 
 	init_local_freq_policy(policy_min, policy_max);
 	initialized = 1;
@@ -682,6 +765,7 @@ void __init cpufreq_ceiling_init(struct perflock_platform_data *pdata)
 		goto invalid_config;
 
 	cpufreq_ceiling_acpu_table_fixup();
+	perflock_register_notifiers();
 
 	init_local_freq_policy(policy_min, policy_max);
 	cpufreq_ceiling_initialized = 1;
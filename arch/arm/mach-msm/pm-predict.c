@@ -0,0 +1,473 @@
+/* arch/arm/mach-msm/pm-predict.c
+ *
+ * Predictive idle sleep mode selection for pm2.c
+ *
+ * arch_idle() only allows a sleep mode whose residency fits before the
+ * next timer.  Interrupts usually end idle much sooner, so on top of that
+ * a menu-style prediction of the actual idle duration is made per CPU:
+ *
+ *  - the time to the next timer is scaled by a correction factor learnt
+ *    per timer range from how long idle really lasted, and
+ *  - if recent idle periods ended by an interrupt (rather than the timer)
+ *    were regular, their typical length is used when it is shorter.
+ *
+ * Modes whose residency exceeds the prediction are then disallowed, so the
+ * deepest mode whose break-even residency is met gets picked.  Each exit is
+ * scored against the chosen mode, see /sys/kernel/debug/msm_pm_predict.
+ *
+ * The policy can be exercised without hardware by writing
+ * "<timer_us> <idle_us>" lines to /sys/kernel/debug/msm_pm_predict_sim,
+ * which replays them through a separate instance of the governor and
+ * reports its decisions when read back ("reset" clears it).
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "pm-predict.h"
+
+static int msm_pm_predict_enable = 1;
+module_param_named(enable, msm_pm_predict_enable,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+#define PREDICT_HISTORY		8
+#define PREDICT_BUCKETS		6
+#define PREDICT_RESOLUTION	1024
+#define PREDICT_DECAY		8
+#define PREDICT_UNITY		(PREDICT_RESOLUTION * PREDICT_DECAY)
+#define PREDICT_MAX_US		(1U << 22)	/* ~4s, keeps sums in range */
+
+/* Idle modes from shallowest to deepest */
+static const int msm_pm_predict_depth[] = {
+	MSM_PM_SLEEP_MODE_WAIT_FOR_INTERRUPT,
+	MSM_PM_SLEEP_MODE_RAMP_DOWN_AND_WAIT_FOR_INTERRUPT,
+	MSM_PM_SLEEP_MODE_POWER_COLLAPSE_STANDALONE,
+	MSM_PM_SLEEP_MODE_APPS_SLEEP,
+	MSM_PM_SLEEP_MODE_POWER_COLLAPSE_NO_XO_SHUTDOWN,
+	MSM_PM_SLEEP_MODE_POWER_COLLAPSE,
+};
+
+struct msm_pm_predict_stats {
+	u32 samples;
+	u32 hit;		/* chosen mode was the right one */
+	u32 too_deep;		/* woke up before the mode's residency */
+	u32 too_shallow;	/* a deeper allowed mode would have paid off */
+	u32 timer_wakeups;
+	u32 irq_wakeups;
+	u64 abs_error_us;
+	u32 mode_count[MSM_PM_SLEEP_MODE_NR];
+};
+
+struct msm_pm_predict {
+	unsigned int intervals[PREDICT_HISTORY];	/* irq wakeups, us */
+	unsigned int nr_intervals;
+	unsigned int interval_ptr;
+	unsigned int correction[PREDICT_BUCKETS];
+
+	/* state of the current idle period */
+	bool active;
+	unsigned int bucket;
+	unsigned int timer_us;
+	unsigned int predicted_us;
+	unsigned int allowed;		/* modes allowed before prediction */
+	ktime_t entry;
+
+	struct msm_pm_predict_stats stats;
+};
+
+static struct msm_pm_platform_data *msm_pm_predict_modes;
+static DEFINE_PER_CPU(struct msm_pm_predict, msm_pm_predict_data);
+
+static void msm_pm_predict_reset(struct msm_pm_predict *p)
+{
+	int i;
+
+	memset(p, 0, sizeof(*p));
+	for (i = 0; i < PREDICT_BUCKETS; i++)
+		p->correction[i] = PREDICT_UNITY;
+}
+
+/* Timer ranges sharing a correction factor: <10us, <100us, ... >=1s */
+static unsigned int msm_pm_predict_bucket(unsigned int us)
+{
+	unsigned int bucket = 0, limit = 10;
+
+	while (bucket < PREDICT_BUCKETS - 1 && us >= limit) {
+		bucket++;
+		limit *= 10;
+	}
+	return bucket;
+}
+
+/*
+ * Typical length of recent interrupt-terminated idle periods, or UINT_MAX
+ * if they are too irregular.  Outliers above the average are dropped one
+ * at a time until the set is tight enough.
+ */
+static unsigned int msm_pm_predict_typical(struct msm_pm_predict *p)
+{
+	unsigned int n = p->nr_intervals;
+	unsigned int max = UINT_MAX;
+	int tries;
+
+	if (n < PREDICT_HISTORY / 2)
+		return UINT_MAX;
+
+	for (tries = 0; tries < 3; tries++) {
+		u64 sum = 0, sq = 0, avg, var;
+		unsigned int i, cnt = 0, top = 0;
+
+		for (i = 0; i < n; i++) {
+			unsigned int v = p->intervals[i];
+
+			if (v > max)
+				continue;
+			sum += v;
+			cnt++;
+			if (v > top)
+				top = v;
+		}
+		if (cnt < PREDICT_HISTORY / 2)
+			break;
+		avg = div_u64(sum, cnt);
+		for (i = 0; i < n; i++) {
+			unsigned int v = p->intervals[i];
+			s64 d;
+
+			if (v > max)
+				continue;
+			d = (s64)v - (s64)avg;
+			sq += (u64)(d * d);
+		}
+		var = div_u64(sq, cnt);
+
+		/* stddev <= 20us, or stddev <= avg / 6 */
+		if (var <= 400 || avg * avg > 36 * var)
+			return (unsigned int)avg;
+		max = top - 1;
+	}
+	return UINT_MAX;
+}
+
+static unsigned int msm_pm_predict_us(struct msm_pm_predict *p,
+				      unsigned int timer_us)
+{
+	unsigned int predicted, typical;
+
+	p->bucket = msm_pm_predict_bucket(timer_us);
+	predicted = (unsigned int)div_u64((u64)timer_us *
+			p->correction[p->bucket] + PREDICT_UNITY / 2,
+			PREDICT_UNITY);
+
+	typical = msm_pm_predict_typical(p);
+	return min(predicted, typical);
+}
+
+static int msm_pm_predict_deepest(unsigned int allowed)
+{
+	int d;
+
+	for (d = ARRAY_SIZE(msm_pm_predict_depth) - 1; d >= 0; d--)
+		if (allowed & (1U << msm_pm_predict_depth[d]))
+			return msm_pm_predict_depth[d];
+	return -1;
+}
+
+/*
+ * Disallow modes whose residency is not met by the prediction.  The
+ * shallowest allowed mode is always kept so arch_idle() never has to spin.
+ */
+static void __msm_pm_predict_select(struct msm_pm_predict *p, bool *allow,
+				    unsigned int timer_us)
+{
+	struct msm_pm_platform_data *modes = msm_pm_predict_modes;
+	bool kept = false;
+	int d;
+
+	p->timer_us = timer_us;
+	p->predicted_us = msm_pm_predict_us(p, timer_us);
+	p->allowed = 0;
+
+	for (d = 0; d < ARRAY_SIZE(msm_pm_predict_depth); d++) {
+		int i = msm_pm_predict_depth[d];
+
+		if (!allow[i])
+			continue;
+		p->allowed |= 1U << i;
+		if (kept && modes[i].residency > p->predicted_us)
+			allow[i] = false;
+		kept = true;
+	}
+	p->active = true;
+}
+
+static void __msm_pm_predict_reflect(struct msm_pm_predict *p, int mode,
+				     unsigned int idle_us)
+{
+	struct msm_pm_platform_data *modes = msm_pm_predict_modes;
+	struct msm_pm_predict_stats *st = &p->stats;
+	unsigned int measured = min(idle_us, p->timer_us);
+	unsigned int timer_us, factor;
+	int deepest;
+
+	p->active = false;
+	st->samples++;
+	st->abs_error_us += abs((int)min(idle_us, PREDICT_MAX_US) -
+				(int)min(p->predicted_us, PREDICT_MAX_US));
+
+	if (mode >= 0) {
+		st->mode_count[mode]++;
+		deepest = msm_pm_predict_deepest(p->allowed);
+		if (idle_us < modes[mode].residency)
+			st->too_deep++;
+		else if (deepest != mode && deepest >= 0 &&
+			 idle_us >= modes[deepest].residency)
+			st->too_shallow++;
+		else
+			st->hit++;
+	}
+
+	/* Ended at (about) the next timer, so not by an interrupt */
+	if (measured >= p->timer_us - p->timer_us / 16) {
+		st->timer_wakeups++;
+	} else {
+		st->irq_wakeups++;
+		p->intervals[p->interval_ptr] = min(idle_us, PREDICT_MAX_US);
+		p->interval_ptr = (p->interval_ptr + 1) % PREDICT_HISTORY;
+		if (p->nr_intervals < PREDICT_HISTORY)
+			p->nr_intervals++;
+	}
+
+	/* long timers are clamped, not skipped, so they still correct */
+	timer_us = min(p->timer_us, PREDICT_MAX_US);
+	measured = min(measured, timer_us);
+	factor = p->correction[p->bucket];
+	factor -= factor / PREDICT_DECAY;
+	if (timer_us)
+		factor += (unsigned int)div_u64((u64)PREDICT_RESOLUTION *
+						measured, timer_us);
+	else
+		factor += PREDICT_RESOLUTION;
+	p->correction[p->bucket] = factor ? factor : 1;
+}
+
+void msm_pm_predict_select(bool *allow, int64_t timer_expiration)
+{
+	struct msm_pm_predict *p = &__get_cpu_var(msm_pm_predict_data);
+	unsigned int timer_us;
+
+	if (!msm_pm_predict_enable || !msm_pm_predict_modes)
+		return;
+
+	if (timer_expiration >= (int64_t)UINT_MAX * NSEC_PER_USEC)
+		timer_us = UINT_MAX;
+	else if (timer_expiration > 0)
+		timer_us = (unsigned int)div_u64(timer_expiration,
+						 NSEC_PER_USEC);
+	else
+		timer_us = 0;
+
+	__msm_pm_predict_select(p, allow, timer_us);
+	p->entry = ktime_get();
+}
+
+/* @mode is the sleep mode arch_idle() entered, -1 if it spun */
+void msm_pm_predict_reflect(int mode)
+{
+	struct msm_pm_predict *p = &__get_cpu_var(msm_pm_predict_data);
+	s64 us;
+
+	if (!p->active)
+		return;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), p->entry));
+	__msm_pm_predict_reflect(p, mode,
+				 us > UINT_MAX ? UINT_MAX : (unsigned int)us);
+}
+
+void __init msm_pm_predict_init(struct msm_pm_platform_data *modes)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		msm_pm_predict_reset(&per_cpu(msm_pm_predict_data, cpu));
+	msm_pm_predict_modes = modes;
+}
+
+/******************************************************************************
+ * Debugfs
+ *****************************************************************************/
+
+static struct msm_pm_predict msm_pm_predict_sim;
+static DEFINE_MUTEX(msm_pm_predict_sim_lock);
+
+static void msm_pm_predict_show_one(struct seq_file *m,
+				    struct msm_pm_predict *p)
+{
+	struct msm_pm_predict_stats *st = &p->stats;
+	int i;
+
+	seq_printf(m, "  samples %u hit %u too_deep %u too_shallow %u\n",
+		   st->samples, st->hit, st->too_deep, st->too_shallow);
+	seq_printf(m, "  wakeups timer %u irq %u, mean |error| %llu us\n",
+		   st->timer_wakeups, st->irq_wakeups,
+		   st->samples ? (unsigned long long)
+		   div_u64(st->abs_error_us, st->samples) : 0ULL);
+	seq_printf(m, "  typical irq interval %u us\n",
+		   msm_pm_predict_typical(p));
+	seq_puts(m, "  correction");
+	for (i = 0; i < PREDICT_BUCKETS; i++)
+		seq_printf(m, " %u", p->correction[i] * 100 / PREDICT_UNITY);
+	seq_puts(m, " %\n");
+	for (i = 0; i < ARRAY_SIZE(msm_pm_predict_depth); i++) {
+		int mode = msm_pm_predict_depth[i];
+
+		seq_printf(m, "  mode %d residency %u us: %u\n", mode,
+			   msm_pm_predict_modes ?
+			   msm_pm_predict_modes[mode].residency : 0,
+			   st->mode_count[mode]);
+	}
+}
+
+static int msm_pm_predict_show(struct seq_file *m, void *unused)
+{
+	int cpu;
+
+	seq_printf(m, "enabled %d\n", msm_pm_predict_enable);
+	for_each_online_cpu(cpu) {
+		seq_printf(m, "cpu%d:\n", cpu);
+		msm_pm_predict_show_one(m, &per_cpu(msm_pm_predict_data, cpu));
+	}
+	return 0;
+}
+
+static int msm_pm_predict_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_pm_predict_show, NULL);
+}
+
+static const struct file_operations msm_pm_predict_fops = {
+	.open = msm_pm_predict_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int msm_pm_predict_sim_show(struct seq_file *m, void *unused)
+{
+	mutex_lock(&msm_pm_predict_sim_lock);
+	seq_puts(m, "sim:\n");
+	msm_pm_predict_show_one(m, &msm_pm_predict_sim);
+	mutex_unlock(&msm_pm_predict_sim_lock);
+	return 0;
+}
+
+static int msm_pm_predict_sim_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_pm_predict_sim_show, NULL);
+}
+
+/*
+ * One idle period: filter the modes like arch_idle() does (enabled for
+ * idle and residency before the next timer), let the governor choose, and
+ * score the choice against the given idle time.
+ */
+static void msm_pm_predict_sim_step(unsigned int timer_us,
+				    unsigned int idle_us)
+{
+	struct msm_pm_platform_data *modes = msm_pm_predict_modes;
+	bool allow[MSM_PM_SLEEP_MODE_NR];
+	unsigned int allowed = 0;
+	int i;
+
+	for (i = 0; i < MSM_PM_SLEEP_MODE_NR; i++) {
+		allow[i] = modes[i].idle_supported && modes[i].idle_enabled &&
+			modes[i].residency < timer_us;
+		if (i == MSM_PM_SLEEP_MODE_POWER_COLLAPSE_SUSPEND)
+			allow[i] = false;
+	}
+
+	__msm_pm_predict_select(&msm_pm_predict_sim, allow, timer_us);
+	for (i = 0; i < MSM_PM_SLEEP_MODE_NR; i++)
+		if (allow[i])
+			allowed |= 1U << i;
+	__msm_pm_predict_reflect(&msm_pm_predict_sim,
+				 msm_pm_predict_deepest(allowed), idle_us);
+}
+
+static ssize_t msm_pm_predict_sim_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	char line[64];
+	size_t done = 0;
+
+	if (!msm_pm_predict_modes)
+		return -ENODEV;
+
+	mutex_lock(&msm_pm_predict_sim_lock);
+	while (done < count) {
+		size_t len = min(count - done, sizeof(line) - 1);
+		unsigned int timer_us, idle_us;
+		char *nl;
+
+		if (copy_from_user(line, buf + done, len)) {
+			mutex_unlock(&msm_pm_predict_sim_lock);
+			return -EFAULT;
+		}
+		line[len] = '\0';
+		nl = strchr(line, '\n');
+		if (nl) {
+			*nl = '\0';
+			len = nl - line + 1;
+		} else if (done || done + len < count) {
+			/* too long, or a partial line left for the next write */
+			break;
+		}
+
+		if (!strncmp(line, "reset", 5))
+			msm_pm_predict_reset(&msm_pm_predict_sim);
+		else if (sscanf(line, "%u %u", &timer_us, &idle_us) == 2)
+			msm_pm_predict_sim_step(timer_us, idle_us);
+		else if (line[0] != '\0' && line[0] != '#')
+			break;
+		done += len;
+	}
+	mutex_unlock(&msm_pm_predict_sim_lock);
+
+	return done ? done : -EINVAL;
+}
+
+static const struct file_operations msm_pm_predict_sim_fops = {
+	.open = msm_pm_predict_sim_open,
+	.read = seq_read,
+	.write = msm_pm_predict_sim_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init msm_pm_predict_debugfs_init(void)
+{
+	msm_pm_predict_reset(&msm_pm_predict_sim);
+	debugfs_create_file("msm_pm_predict", S_IRUGO, NULL, NULL,
+			    &msm_pm_predict_fops);
+	debugfs_create_file("msm_pm_predict_sim", S_IRUGO | S_IWUSR, NULL,
+			    NULL, &msm_pm_predict_sim_fops);
+	return 0;
+}
+late_initcall(msm_pm_predict_debugfs_init);
@@ -0,0 +1,32 @@
+/* arch/arm/mach-msm/pm-predict.h
+ *
+ * Predictive idle sleep mode selection for pm2.c
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef _ARCH_ARM_MACH_MSM_PM_PREDICT_H
+#define _ARCH_ARM_MACH_MSM_PM_PREDICT_H
+
+#include "pm.h"
+
+#ifdef CONFIG_MSM_IDLE_PREDICT
+void msm_pm_predict_init(struct msm_pm_platform_data *modes);
+void msm_pm_predict_select(bool *allow, int64_t timer_expiration);
+void msm_pm_predict_reflect(int mode);
+#else
+static inline void msm_pm_predict_init(struct msm_pm_platform_data *modes) {}
+static inline void msm_pm_predict_select(bool *allow,
+					 int64_t timer_expiration) {}
+static inline void msm_pm_predict_reflect(int mode) {}
+#endif
+
+#endif
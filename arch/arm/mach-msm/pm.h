@@ -82,6 +82,26 @@ static inline void msm_pm_set_rpm_wakeup_irq(unsigned int irq) {}
 static inline int msm_pm_platform_secondary_init(unsigned int cpu)
 { return -ENOSYS; }
 #endif
+struct platform_device;
+
+/*
+ * Board files opt platform devices (and everything registered below
+ * them) into async suspend/resume, with @consumer resumed only after
+ * @supplier.
+ */
+struct msm_pm_async_dep {
+	struct platform_device *consumer;
+	struct platform_device *supplier;
+};
+
+#ifdef CONFIG_PM_SLEEP
+void msm_pm_async_init(struct platform_device **devs, int ndevs,
+		       const struct msm_pm_async_dep *deps, int ndeps);
+#else
+static inline void msm_pm_async_init(struct platform_device **devs,
+		int ndevs, const struct msm_pm_async_dep *deps, int ndeps) {}
+#endif
+
 int print_gpio_buffer(struct seq_file *m);
 int free_gpio_buffer(void);
 
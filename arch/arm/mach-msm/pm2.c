@@ -61,6 +61,7 @@
 #include "spm.h"
 #include "sirc.h"
 #include "pm-boot.h"
+#include "pm-predict.h"
 #include <mach/board.h>
 
 /******************************************************************************
@@ -412,6 +413,7 @@ void __init msm_pm_set_platform_data(
 {
 	BUG_ON(MSM_PM_SLEEP_MODE_NR != count);
 	msm_pm_modes = data;
+	msm_pm_predict_init(data);
 }
 
 
@@ -1443,6 +1445,7 @@ void arch_idle(void)
 	int64_t timer_expiration;
 
 	int low_power;
+	int idle_mode = -1;
 	int ret;
 	int i;
 
@@ -1510,6 +1513,9 @@ void arch_idle(void)
 			allow[i] = false;
 	}
 
+	/* Drop modes the predicted idle time will not pay off for */
+	msm_pm_predict_select(allow, timer_expiration);
+
 	if (allow[MSM_PM_SLEEP_MODE_POWER_COLLAPSE] ||
 		allow[MSM_PM_SLEEP_MODE_POWER_COLLAPSE_NO_XO_SHUTDOWN]) {
 		uint32_t wait_us = CONFIG_MSM_IDLE_WAIT_ON_MODEM;
@@ -1548,8 +1554,12 @@ void arch_idle(void)
 		if (sleep_delay == 0) /* 0 would mean infinite time */
 			sleep_delay = 1;
 
-		if (!allow[MSM_PM_SLEEP_MODE_POWER_COLLAPSE])
+		if (!allow[MSM_PM_SLEEP_MODE_POWER_COLLAPSE]) {
 			sleep_limit = SLEEP_LIMIT_NO_TCXO_SHUTDOWN;
+			idle_mode =
+				MSM_PM_SLEEP_MODE_POWER_COLLAPSE_NO_XO_SHUTDOWN;
+		} else
+			idle_mode = MSM_PM_SLEEP_MODE_POWER_COLLAPSE;
 
 #if defined(CONFIG_MSM_MEMORY_LOW_POWER_MODE_IDLE_ACTIVE)
 		sleep_limit |= SLEEP_RESOURCE_MEMORY_BIT1;
@@ -1578,6 +1588,7 @@ void arch_idle(void)
 
 		ret = msm_pm_apps_sleep(sleep_delay, sleep_limit);
 		low_power = 0;
+		idle_mode = MSM_PM_SLEEP_MODE_APPS_SLEEP;
 
 #ifdef CONFIG_MSM_IDLE_STATS
 		if (ret)
@@ -1588,6 +1599,7 @@ void arch_idle(void)
 	} else if (allow[MSM_PM_SLEEP_MODE_POWER_COLLAPSE_STANDALONE]) {
 		ret = msm_pm_power_collapse_standalone(true);
 		low_power = 0;
+		idle_mode = MSM_PM_SLEEP_MODE_POWER_COLLAPSE_STANDALONE;
 #ifdef CONFIG_MSM_IDLE_STATS
 		exit_stat = ret ?
 			MSM_PM_STAT_IDLE_FAILED_STANDALONE_POWER_COLLAPSE :
@@ -1599,12 +1611,14 @@ void arch_idle(void)
 			while (!msm_irq_pending())
 				udelay(1);
 		low_power = 0;
+		idle_mode = MSM_PM_SLEEP_MODE_RAMP_DOWN_AND_WAIT_FOR_INTERRUPT;
 #ifdef CONFIG_MSM_IDLE_STATS
 		exit_stat = ret ? MSM_PM_STAT_IDLE_SPIN : MSM_PM_STAT_IDLE_WFI;
 #endif /* CONFIG_MSM_IDLE_STATS */
 	} else if (allow[MSM_PM_SLEEP_MODE_WAIT_FOR_INTERRUPT]) {
 		msm_pm_swfi(true, false);
 		low_power = 0;
+		idle_mode = MSM_PM_SLEEP_MODE_WAIT_FOR_INTERRUPT;
 #ifdef CONFIG_MSM_IDLE_STATS
 		exit_stat = MSM_PM_STAT_IDLE_WFI;
 #endif /* CONFIG_MSM_IDLE_STATS */
@@ -1619,6 +1633,7 @@ void arch_idle(void)
 
 arch_idle_exit:
 	msm_timer_exit_idle(low_power);
+	msm_pm_predict_reflect(idle_mode);
 
 #ifdef CONFIG_MSM_IDLE_STATS
 	t2 = ktime_to_ns(ktime_get());
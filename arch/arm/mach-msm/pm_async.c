@@ -0,0 +1,57 @@
+/* arch/arm/mach-msm/pm_async.c
+ *
+ * Async suspend/resume setup for board devices.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/device.h>
+#include <linux/platform_device.h>
+#include <linux/pm.h>
+
+#include "pm.h"
+
+/**
+ * msm_pm_async_init - let board devices suspend and resume in parallel
+ * @devs: platform devices to make asynchronous, with their subtrees
+ * @ndevs: number of entries in @devs
+ * @deps: ordering constraints between devices, may be NULL
+ * @ndeps: number of entries in @deps
+ *
+ * Call after the devices have been registered.  Devices that were not
+ * registered (e.g. a disabled SDCC slot) are skipped.
+ */
+void __init msm_pm_async_init(struct platform_device **devs, int ndevs,
+			      const struct msm_pm_async_dep *deps, int ndeps)
+{
+	int i, ret;
+
+	for (i = 0; i < ndevs; i++) {
+		if (!device_is_registered(&devs[i]->dev))
+			continue;
+		device_enable_async_subtree(&devs[i]->dev);
+	}
+
+	for (i = 0; i < ndeps; i++) {
+		struct device *consumer = &deps[i].consumer->dev;
+		struct device *supplier = &deps[i].supplier->dev;
+
+		if (!device_is_registered(consumer) ||
+		    !device_is_registered(supplier))
+			continue;
+		ret = device_pm_add_dependency(consumer, supplier);
+		if (ret)
+			pr_err("%s: %s -> %s failed, %d\n", __func__,
+			       dev_name(consumer), dev_name(supplier), ret);
+	}
+}
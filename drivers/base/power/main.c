@@ -28,6 +28,7 @@
 #include <linux/async.h>
 #include <linux/suspend.h>
 #include <linux/timer.h>
+#include <linux/slab.h>
 
 #include "../base.h"
 #include "power.h"
@@ -50,6 +51,22 @@ LIST_HEAD(dpm_noirq_list);
 static DEFINE_MUTEX(dpm_list_mtx);
 static pm_message_t pm_transition;
 
+/*
+ * Explicit ordering between devices that are not parent and child.  A
+ * consumer is resumed after, and suspended before, each of its
+ * suppliers, just as a child is with respect to its parent.  The lists
+ * are changed under dpm_list_mtx and dpm_dep_lock, and read under
+ * dpm_dep_lock only, so they can be walked from async callbacks.
+ */
+struct pm_dependency {
+	struct device *consumer;
+	struct device *supplier;
+	struct list_head consumer_entry;	/* supplier->power.consumers */
+	struct list_head supplier_entry;	/* consumer->power.suppliers */
+};
+
+static DEFINE_SPINLOCK(dpm_dep_lock);
+
 static void dpm_drv_timeout(unsigned long data);
 struct dpm_drv_wd_data {
 	struct device *dev;
@@ -72,6 +89,8 @@ void device_pm_init(struct device *dev)
 	spin_lock_init(&dev->power.lock);
 	pm_runtime_init(dev);
 	INIT_LIST_HEAD(&dev->power.entry);
+	INIT_LIST_HEAD(&dev->power.suppliers);
+	INIT_LIST_HEAD(&dev->power.consumers);
 }
 
 /**
@@ -102,10 +121,14 @@ void device_pm_add(struct device *dev)
 	if (dev->parent && dev->parent->power.is_prepared)
 		dev_warn(dev, "parent %s should not be sleeping\n",
 			dev_name(dev->parent));
+	if (dev->parent && dev->parent->power.async_subtree)
+		device_enable_async_subtree(dev);
 	list_add_tail(&dev->power.entry, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
 }
 
+static void dpm_drop_dependencies(struct device *dev);
+
 /**
  * device_pm_remove - Remove a device from the PM core's list of active devices.
  * @dev: Device to be removed from the list.
@@ -117,6 +140,7 @@ void device_pm_remove(struct device *dev)
 	complete_all(&dev->power.completion);
 	mutex_lock(&dpm_list_mtx);
 	list_del_init(&dev->power.entry);
+	dpm_drop_dependencies(dev);
 	mutex_unlock(&dpm_list_mtx);
 	device_wakeup_disable(dev);
 	pm_runtime_remove(dev);
@@ -214,6 +238,170 @@ static void dpm_wait_for_children(struct device *dev, bool async)
        device_for_each_child(dev, &async, dpm_wait_fn);
 }
 
+/*
+ * Return the @n-th supplier (or consumer) of @dev with a reference held,
+ * so that the wait happens without dpm_dep_lock.  Devices have only a
+ * handful of dependencies, the quadratic walk does not matter.
+ */
+static struct device *dpm_dep_get(struct device *dev, bool suppliers, int n)
+{
+	struct pm_dependency *dep;
+	struct device *ret = NULL;
+
+	spin_lock(&dpm_dep_lock);
+	if (suppliers) {
+		list_for_each_entry(dep, &dev->power.suppliers, supplier_entry)
+			if (!n--) {
+				ret = get_device(dep->supplier);
+				break;
+			}
+	} else {
+		list_for_each_entry(dep, &dev->power.consumers, consumer_entry)
+			if (!n--) {
+				ret = get_device(dep->consumer);
+				break;
+			}
+	}
+	spin_unlock(&dpm_dep_lock);
+	return ret;
+}
+
+static void dpm_wait_for_deps(struct device *dev, bool suppliers, bool async)
+{
+	struct device *other;
+	int n;
+
+	for (n = 0; (other = dpm_dep_get(dev, suppliers, n)); n++) {
+		dpm_wait(other, async);
+		put_device(other);
+	}
+}
+
+static bool dpm_depends_on(struct device *dev, struct device *target)
+{
+	struct pm_dependency *dep;
+
+	if (dev == target)
+		return true;
+	if (dev->parent && dpm_depends_on(dev->parent, target))
+		return true;
+	list_for_each_entry(dep, &dev->power.suppliers, supplier_entry)
+		if (dpm_depends_on(dep->supplier, target))
+			return true;
+	return false;
+}
+
+static int dpm_reorder_fn(struct device *dev, void *unused);
+
+/* Move @dev and everything that depends on it to the end of dpm_list. */
+static void dpm_reorder_to_tail(struct device *dev)
+{
+	struct pm_dependency *dep;
+
+	list_move_tail(&dev->power.entry, &dpm_list);
+	device_for_each_child(dev, NULL, dpm_reorder_fn);
+	list_for_each_entry(dep, &dev->power.consumers, consumer_entry)
+		dpm_reorder_to_tail(dep->consumer);
+}
+
+static int dpm_reorder_fn(struct device *dev, void *unused)
+{
+	dpm_reorder_to_tail(dev);
+	return 0;
+}
+
+/**
+ * device_pm_add_dependency - Order system suspend/resume of two devices.
+ * @consumer: Device that needs @supplier to be functional.
+ * @supplier: Device @consumer depends on.
+ *
+ * @consumer will be resumed after @supplier and suspended before it, also
+ * when both are handled asynchronously.  Both devices must be registered
+ * and no system power transition may be in progress.
+ */
+int device_pm_add_dependency(struct device *consumer, struct device *supplier)
+{
+	struct pm_dependency *dep;
+	int error = 0;
+
+	if (!consumer || !supplier ||
+	    !device_is_registered(consumer) || !device_is_registered(supplier))
+		return -ENODEV;
+
+	dep = kzalloc(sizeof(*dep), GFP_KERNEL);
+	if (!dep)
+		return -ENOMEM;
+
+	mutex_lock(&dpm_list_mtx);
+	if (consumer->power.is_prepared || supplier->power.is_prepared) {
+		error = -EBUSY;
+		goto out;
+	}
+	if (dpm_depends_on(supplier, consumer)) {
+		dev_err(consumer, "PM dependency on %s would form a loop\n",
+			dev_name(supplier));
+		error = -EINVAL;
+		goto out;
+	}
+
+	dep->consumer = consumer;
+	dep->supplier = supplier;
+	spin_lock(&dpm_dep_lock);
+	list_add_tail(&dep->supplier_entry, &consumer->power.suppliers);
+	list_add_tail(&dep->consumer_entry, &supplier->power.consumers);
+	spin_unlock(&dpm_dep_lock);
+
+	/* Synchronous devices rely on the list order, as for parents. */
+	if (!list_empty(&consumer->power.entry))
+		dpm_reorder_to_tail(consumer);
+	dep = NULL;
+ out:
+	mutex_unlock(&dpm_list_mtx);
+	kfree(dep);
+	return error;
+}
+EXPORT_SYMBOL_GPL(device_pm_add_dependency);
+
+static void dpm_free_dependency(struct pm_dependency *dep)
+{
+	spin_lock(&dpm_dep_lock);
+	list_del(&dep->supplier_entry);
+	list_del(&dep->consumer_entry);
+	spin_unlock(&dpm_dep_lock);
+	kfree(dep);
+}
+
+/**
+ * device_pm_remove_dependency - Undo device_pm_add_dependency().
+ * @consumer: Consumer device.
+ * @supplier: Supplier device.
+ */
+void device_pm_remove_dependency(struct device *consumer,
+				 struct device *supplier)
+{
+	struct pm_dependency *dep;
+
+	mutex_lock(&dpm_list_mtx);
+	list_for_each_entry(dep, &consumer->power.suppliers, supplier_entry)
+		if (dep->supplier == supplier) {
+			dpm_free_dependency(dep);
+			break;
+		}
+	mutex_unlock(&dpm_list_mtx);
+}
+EXPORT_SYMBOL_GPL(device_pm_remove_dependency);
+
+/* Called with dpm_list_mtx held when @dev goes away. */
+static void dpm_drop_dependencies(struct device *dev)
+{
+	struct pm_dependency *dep, *n;
+
+	list_for_each_entry_safe(dep, n, &dev->power.suppliers, supplier_entry)
+		dpm_free_dependency(dep);
+	list_for_each_entry_safe(dep, n, &dev->power.consumers, consumer_entry)
+		dpm_free_dependency(dep);
+}
+
 /**
  * pm_op - Execute the PM operation appropriate for given PM event.
  * @dev: Device to handle.
@@ -514,11 +702,14 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
 static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
 	int error = 0;
+	ktime_t starttime;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
 	dpm_wait(dev->parent, async);
+	dpm_wait_for_deps(dev, true, async);
+	starttime = ktime_get();
 	device_lock(dev);
 
 	/*
@@ -569,6 +760,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
  Unlock:
 	device_unlock(dev);
+	suspend_time_dev_record(dev, true, async, starttime);
 	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
@@ -633,6 +825,7 @@ void dpm_resume(pm_message_t state)
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
+	suspend_time_dev_begin(true);
 
 	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
 		INIT_COMPLETION(dev->power.completion);
@@ -662,6 +855,7 @@ void dpm_resume(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	suspend_time_dev_end(true, starttime);
 	dpm_show_time(starttime, state, NULL);
 }
 
@@ -876,8 +1070,11 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	int error = 0;
 	struct timer_list timer;
 	struct dpm_drv_wd_data data;
+	ktime_t starttime;
 
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_deps(dev, false, async);
+	starttime = ktime_get();
 
 	data.dev = dev;
 	data.tsk = get_current();
@@ -936,6 +1133,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 
  Unlock:
 	device_unlock(dev);
+	suspend_time_dev_record(dev, false, async, starttime);
 
 	del_timer_sync(&timer);
 	destroy_timer_on_stack(&timer);
@@ -987,6 +1185,7 @@ int dpm_suspend(pm_message_t state)
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
+	suspend_time_dev_begin(false);
 	while (!list_empty(&dpm_prepared_list)) {
 		struct device *dev = to_device(dpm_prepared_list.prev);
 
@@ -1009,6 +1208,7 @@ int dpm_suspend(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	suspend_time_dev_end(false, starttime);
 	if (!error)
 		error = async_error;
 	if (!error)
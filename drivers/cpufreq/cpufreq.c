@@ -134,14 +134,17 @@ static unsigned int __cpufreq_get(unsigned int cpu);
 static void handle_update(struct work_struct *work);
 
 /**
- * Two notifier lists: the "policy" list is involved in the
+ * Three notifier lists: the "policy" list is involved in the
  * validation process for a new CPU frequency policy; the
  * "transition" list for kernel code that needs to handle
- * changes to devices when the CPU clock speed changes.
- * The mutex locks both lists.
+ * changes to devices when the CPU clock speed changes; the
+ * "boost" list for governors that can raise the speed at once
+ * when asked to by cpufreq_boost(), e.g. on user input.
+ * The mutex locks the first two lists.
  */
 static BLOCKING_NOTIFIER_HEAD(cpufreq_policy_notifier_list);
 static struct srcu_notifier_head cpufreq_transition_notifier_list;
+static ATOMIC_NOTIFIER_HEAD(cpufreq_boost_notifier_list);
 
 static bool init_cpufreq_transition_notifier_list_called;
 static int __init init_cpufreq_transition_notifier_list(void)
@@ -1623,12 +1626,14 @@ static struct syscore_ops cpufreq_syscore_ops = {
 /**
  *	cpufreq_register_notifier - register a driver with cpufreq
  *	@nb: notifier function to register
- *      @list: CPUFREQ_TRANSITION_NOTIFIER or CPUFREQ_POLICY_NOTIFIER
+ *      @list: CPUFREQ_TRANSITION_NOTIFIER, CPUFREQ_POLICY_NOTIFIER or
+ *		CPUFREQ_BOOST_NOTIFIER
  *
- *	Add a driver to one of two lists: either a list of drivers that
+ *	Add a driver to one of three lists: either a list of drivers that
  *      are notified about clock rate changes (once before and once after
- *      the transition), or a list of drivers that are notified about
- *      changes in cpufreq policy.
+ *      the transition), a list of drivers that are notified about
+ *      changes in cpufreq policy, or a list of governors that are asked
+ *      to boost by cpufreq_boost().
  *
  *	This function may sleep, and has the same return conditions as
  *	blocking_notifier_chain_register.
@@ -1648,6 +1653,10 @@ int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list)
 		ret = blocking_notifier_chain_register(
 				&cpufreq_policy_notifier_list, nb);
 		break;
+	case CPUFREQ_BOOST_NOTIFIER:
+		ret = atomic_notifier_chain_register(
+				&cpufreq_boost_notifier_list, nb);
+		break;
 	default:
 		ret = -EINVAL;
 	}
@@ -1660,7 +1669,8 @@ EXPORT_SYMBOL(cpufreq_register_notifier);
 /**
  *	cpufreq_unregister_notifier - unregister a driver with cpufreq
  *	@nb: notifier block to be unregistered
- *      @list: CPUFREQ_TRANSITION_NOTIFIER or CPUFREQ_POLICY_NOTIFIER
+ *      @list: CPUFREQ_TRANSITION_NOTIFIER, CPUFREQ_POLICY_NOTIFIER or
+ *		CPUFREQ_BOOST_NOTIFIER
  *
  *	Remove a driver from the CPU frequency notifier list.
  *
@@ -1680,6 +1690,10 @@ int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list)
 		ret = blocking_notifier_chain_unregister(
 				&cpufreq_policy_notifier_list, nb);
 		break;
+	case CPUFREQ_BOOST_NOTIFIER:
+		ret = atomic_notifier_chain_unregister(
+				&cpufreq_boost_notifier_list, nb);
+		break;
 	default:
 		ret = -EINVAL;
 	}
@@ -1689,6 +1703,26 @@ int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list)
 EXPORT_SYMBOL(cpufreq_unregister_notifier);
 
 
+/**
+ *	cpufreq_boost - ask the governors to raise the CPU speed now
+ *	@freq: frequency to boost to in kHz, 0 for the governor's default
+ *	@duration_us: how long to hold it, 0 for the governor's default
+ *
+ *	Calls the CPUFREQ_BOOST_NOTIFIER list.  Governors that don't
+ *	register there ignore boosts.  May be called from atomic context.
+ */
+void cpufreq_boost(unsigned int freq, unsigned int duration_us)
+{
+	struct cpufreq_boost boost = {
+		.freq		= freq,
+		.duration_us	= duration_us,
+	};
+
+	atomic_notifier_call_chain(&cpufreq_boost_notifier_list, 0, &boost);
+}
+EXPORT_SYMBOL_GPL(cpufreq_boost);
+
+
 /*********************************************************************
  *                              GOVERNORS                            *
  *********************************************************************/
@@ -109,6 +109,8 @@ static int boost_val;
 static int boostpulse_duration_val = DEFAULT_MIN_SAMPLE_TIME;
 /* End time of boost pulse in ktime converted to usecs */
 static u64 boostpulse_endtime;
+/* Speed held by the current boost, hispeed_freq unless boosted by input */
+static unsigned int boostpulse_freq;
 
 /*
  * Max additional time to wait in idle, beyond timer_rate, at speeds above
@@ -119,6 +121,14 @@ static int timer_slack_val = DEFAULT_TIMER_SLACK;
 
 static bool io_is_busy;
 
+/* Take the load from the scheduler's busy time windows. */
+static bool use_sched_load;
+
+/* Ramp up the CPU a high-demand task migrates to. */
+static bool use_migration_notif;
+static atomic_t migration_notif_count;
+static atomic_t migration_ramp_count;
+
 static inline cputime64_t get_cpu_idle_time_jiffy(unsigned int cpu,
 						  cputime64_t *wall)
 {
@@ -379,12 +389,17 @@ static void cpufreq_interactive_timer(unsigned long data)
 	cputime_speedadj = pcpu->cputime_speedadj;
 	spin_unlock_irqrestore(&pcpu->load_lock, flags);
 
-	if (WARN_ON_ONCE(!delta_time))
-		goto rearm;
+	if (use_sched_load) {
+		cpu_load = sched_get_cpu_load(data);
+		loadadjfreq = cpu_load * pcpu->policy->cur;
+	} else {
+		if (WARN_ON_ONCE(!delta_time))
+			goto rearm;
 
-	do_div(cputime_speedadj, delta_time);
-	loadadjfreq = (unsigned int)cputime_speedadj * 100;
-	cpu_load = loadadjfreq / pcpu->policy->cur;
+		do_div(cputime_speedadj, delta_time);
+		loadadjfreq = (unsigned int)cputime_speedadj * 100;
+		cpu_load = loadadjfreq / pcpu->policy->cur;
+	}
 	boosted = boost_val || now < boostpulse_endtime;
 
 	if (cpu_load >= go_hispeed_load) {
@@ -396,6 +411,10 @@ static void cpufreq_interactive_timer(unsigned long data)
 	new_freq = choose_freq(pcpu, loadadjfreq);
 	}
 
+	/* hold the speed requested by boostpulse or an input boost */
+	if (boosted && new_freq < boostpulse_freq)
+		new_freq = boostpulse_freq;
+
 	if (pcpu->target_freq >= hispeed_freq &&
 	    new_freq > pcpu->target_freq &&
 	    now - pcpu->hispeed_validate_time <
@@ -436,16 +455,13 @@ pcpu->hispeed_validate_time = now;
 
 	/*
 	 * Update the timestamp for checking whether speed has been held at
-	 * or above the selected frequency for a minimum of min_sample_time,
-	 * if not boosted to hispeed_freq.  If boosted to hispeed_freq then we
-	 * allow the speed to drop as soon as the boostpulse duration expires
-	 * (or the indefinite boost is turned off).
+	 * or above the selected frequency for a minimum of min_sample_time.
+	 * While boosted new_freq is at least boostpulse_freq, so the floor
+	 * stays at the boosted speed until the boost ends.
 	 */
 
-	if (!boosted || new_freq > hispeed_freq) {
-		pcpu->floor_freq = new_freq;
-		pcpu->floor_validate_time = now;
-	}
+	pcpu->floor_freq = new_freq;
+	pcpu->floor_validate_time = now;
 
 	if (pcpu->target_freq == new_freq &&
 			pcpu->target_freq <= pcpu->policy->cur) {
@@ -496,7 +512,14 @@ static void cpufreq_interactive_idle_start(void)
 
 	pending = timer_pending(&pcpu->cpu_timer);
 
-	if (pcpu->target_freq != pcpu->policy->min) {
+	/*
+	 * With the scheduler's load there is nothing to sample while idle:
+	 * the next tick after this CPU wakes up reports any load change.
+	 */
+	if (use_sched_load && pcpu->target_freq == pcpu->policy->min) {
+		if (pending)
+			del_timer(&pcpu->cpu_timer);
+	} else if (pcpu->target_freq != pcpu->policy->min) {
 		/*
 		 * Entering idle while not at lowest speed.  On some
 		 * platforms this can hold the other CPU(s) at that speed
@@ -598,7 +621,7 @@ static int cpufreq_interactive_speedchange_task(void *data)
 	return 0;
 }
 
-static void cpufreq_interactive_boost(void)
+static void cpufreq_interactive_boost(unsigned int freq)
 {
 	int i;
 	int anyboost = 0;
@@ -606,12 +629,13 @@ static void cpufreq_interactive_boost(void)
 	struct cpufreq_interactive_cpuinfo *pcpu;
 
 	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+	boostpulse_freq = freq;
 
 	for_each_online_cpu(i) {
 		pcpu = &per_cpu(cpuinfo, i);
 
-		if (pcpu->target_freq < hispeed_freq) {
-			pcpu->target_freq = hispeed_freq;
+		if (pcpu->target_freq < freq) {
+			pcpu->target_freq = freq;
 			cpumask_set_cpu(i, &speedchange_cpumask);
 			pcpu->hispeed_validate_time =
 				ktime_to_us(ktime_get());
@@ -623,7 +647,7 @@ static void cpufreq_interactive_boost(void)
 		 * validated.
 		 */
 
-		pcpu->floor_freq = hispeed_freq;
+		pcpu->floor_freq = freq;
 		pcpu->floor_validate_time = ktime_to_us(ktime_get());
 	}
 
@@ -677,6 +701,111 @@ static struct notifier_block cpufreq_notifier_block = {
 	.notifier_call = cpufreq_interactive_notifier,
 };
 
+static int cpufreq_interactive_boost_notifier(
+	struct notifier_block *nb, unsigned long val, void *data)
+{
+	struct cpufreq_boost *boost = data;
+	unsigned int duration = boost->duration_us ? : boostpulse_duration_val;
+	u64 endtime = ktime_to_us(ktime_get()) + duration;
+
+	if (endtime > boostpulse_endtime)
+		boostpulse_endtime = endtime;
+	trace_cpufreq_interactive_boost("input");
+	cpufreq_interactive_boost(boost->freq ? : hispeed_freq);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpufreq_boost_notifier_block = {
+	.notifier_call = cpufreq_interactive_boost_notifier,
+};
+
+/*
+ * Called from the scheduler tick when this CPU's load moved by
+ * sched_freq_alert_pct or more: fire the timer now rather than waiting
+ * for the rest of timer_rate.
+ */
+static int cpufreq_interactive_sched_load_notifier(
+	struct notifier_block *nb, unsigned long load, void *data)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu =
+		&per_cpu(cpuinfo, (unsigned long)data);
+
+	if (!use_sched_load)
+		return NOTIFY_DONE;
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return NOTIFY_DONE;
+	if (pcpu->governor_enabled)
+		mod_timer_pinned(&pcpu->cpu_timer, jiffies);
+	up_read(&pcpu->enable_sem);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpufreq_sched_load_notifier_block = {
+	.notifier_call = cpufreq_interactive_sched_load_notifier,
+};
+
+/*
+ * A task whose recent demand is above sched_freq_migrate_pct moved to
+ * another CPU.  Raise the destination CPU to the speed that demand needs
+ * now, instead of waiting for the load there to build up.
+ */
+static int cpufreq_interactive_migration_notifier(
+	struct notifier_block *nb, unsigned long val, void *data)
+{
+	struct sched_migration_note *note = data;
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	unsigned int src_freq, old_freq, new_freq, index;
+	unsigned long flags;
+	u64 now;
+
+	if (!use_migration_notif)
+		return NOTIFY_DONE;
+	atomic_inc(&migration_notif_count);
+
+	pcpu = &per_cpu(cpuinfo, note->dest_cpu);
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return NOTIFY_DONE;
+	if (!pcpu->governor_enabled)
+		goto exit;
+
+	/* The demand was measured at the source CPU's speed. */
+	src_freq = per_cpu(cpuinfo, note->src_cpu).target_freq;
+	if (!src_freq)
+		src_freq = pcpu->policy->max;
+
+	new_freq = choose_freq(pcpu, note->demand * src_freq);
+	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
+					   new_freq, CPUFREQ_RELATION_L,
+					   &index))
+		goto exit;
+	new_freq = pcpu->freq_table[index].frequency;
+	if (new_freq <= pcpu->target_freq)
+		goto exit;
+
+	now = ktime_to_us(ktime_get());
+	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+	old_freq = pcpu->target_freq;
+	pcpu->target_freq = new_freq;
+	pcpu->floor_freq = new_freq;
+	pcpu->floor_validate_time = now;
+	pcpu->hispeed_validate_time = now;
+	cpumask_set_cpu(note->dest_cpu, &speedchange_cpumask);
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+
+	trace_cpufreq_interactive_target(note->dest_cpu, note->demand,
+					 old_freq, pcpu->policy->cur,
+					 new_freq);
+	atomic_inc(&migration_ramp_count);
+	wake_up_process(speedchange_task);
+exit:
+	up_read(&pcpu->enable_sem);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpufreq_migration_notifier_block = {
+	.notifier_call = cpufreq_interactive_migration_notifier,
+};
+
 static unsigned int *get_tokenized_data(const char *buf, int *num_tokens)
 {
 	const char *cp;
@@ -957,7 +1086,7 @@ static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
 
 	boostpulse_endtime = ktime_to_us(ktime_get()) + boostpulse_duration_val;
 	trace_cpufreq_interactive_boost("pulse");
-	cpufreq_interactive_boost();
+	cpufreq_interactive_boost(hispeed_freq);
 	return count;
 }
 
@@ -1009,6 +1138,69 @@ static ssize_t store_io_is_busy(struct kobject *kobj,
 static struct global_attr io_is_busy_attr = __ATTR(io_is_busy, 0644,
 		show_io_is_busy, store_io_is_busy);
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+static ssize_t show_use_sched_load(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", use_sched_load);
+}
+
+static ssize_t store_use_sched_load(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	use_sched_load = val;
+	return count;
+}
+
+static struct global_attr use_sched_load_attr = __ATTR(use_sched_load, 0644,
+		show_use_sched_load, store_use_sched_load);
+
+static ssize_t show_use_migration_notif(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", use_migration_notif);
+}
+
+static ssize_t store_use_migration_notif(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	use_migration_notif = val;
+	return count;
+}
+
+static struct global_attr use_migration_notif_attr =
+	__ATTR(use_migration_notif, 0644,
+		show_use_migration_notif, store_use_migration_notif);
+
+static ssize_t show_migration_notifs(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", atomic_read(&migration_notif_count));
+}
+
+define_one_global_ro(migration_notifs);
+
+static ssize_t show_migration_ramps(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", atomic_read(&migration_ramp_count));
+}
+
+define_one_global_ro(migration_ramps);
+#endif
+
 static struct attribute *interactive_attributes[] = {
 	&target_loads_attr.attr,
 	&above_hispeed_delay_attr.attr,
@@ -1020,6 +1212,12 @@ static struct attribute *interactive_attributes[] = {
 	&boostpulse.attr,
 	&boostpulse_duration.attr,
 	&io_is_busy_attr.attr,
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	&use_sched_load_attr.attr,
+	&use_migration_notif_attr.attr,
+	&migration_notifs.attr,
+	&migration_ramps.attr,
+#endif
 	&sampling_down_factor_attr.attr,
 	NULL,
 };
@@ -1106,6 +1304,11 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		idle_notifier_register(&cpufreq_interactive_idle_nb);
 		cpufreq_register_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
+		cpufreq_register_notifier(
+			&cpufreq_boost_notifier_block, CPUFREQ_BOOST_NOTIFIER);
+		register_sched_load_notifier(&cpufreq_sched_load_notifier_block);
+		register_sched_migration_notifier(
+			&cpufreq_migration_notifier_block);
 		mutex_unlock(&gov_lock);
 		break;
 
@@ -1125,6 +1328,11 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			return 0;
 		}
 
+		unregister_sched_migration_notifier(
+			&cpufreq_migration_notifier_block);
+		unregister_sched_load_notifier(&cpufreq_sched_load_notifier_block);
+		cpufreq_unregister_notifier(
+			&cpufreq_boost_notifier_block, CPUFREQ_BOOST_NOTIFIER);
 		cpufreq_unregister_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
 		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
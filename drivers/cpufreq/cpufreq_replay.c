@@ -0,0 +1,542 @@
+/*
+ * drivers/cpufreq/cpufreq_replay.c
+ *
+ * Load trace replay for cpufreq governor evaluation.
+ *
+ * A trace is a per-CPU timeline of load segments, each giving a duration
+ * and the load the CPU would see if it ran at its highest frequency.  One
+ * thread per CPU replays its timeline in real time: for every window it
+ * spins for as long as the demanded work takes at the current frequency
+ * and sleeps for the rest, so the governor sees genuine busy and idle
+ * time.  Work that doesn't fit a window is carried over to the next.
+ *
+ * The frequency is never really changed for this purpose: the replay
+ * scales the work by the frequency the governor selected, which makes
+ * it usable with cpufreq_sim on machines without frequency scaling.
+ *
+ * For each CPU the results give the energy proxy (frequency x time), the
+ * time the load at the selected frequency stayed above target_load, and
+ * how long the governor took to reach an adequate frequency after each
+ * upward load step.  See Documentation/cpu-freq/replay.txt.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+
+static unsigned int window_us = 10000;
+module_param(window_us, uint, 0644);
+MODULE_PARM_DESC(window_us, "Replay window (us)");
+
+static unsigned int target_load = 90;
+module_param(target_load, uint, 0644);
+MODULE_PARM_DESC(target_load, "Load (%) above which the CPU counts as too slow");
+
+static unsigned int step_pct = 30;
+module_param(step_pct, uint, 0644);
+MODULE_PARM_DESC(step_pct, "Load increase (% points) that counts as a load step");
+
+#define REPLAY_TRACE_MAX	(256 * 1024)
+
+struct replay_seg {
+	unsigned int duration_us;
+	unsigned int load;		/* % of the highest frequency */
+};
+
+struct replay_cpu {
+	struct task_struct *task;
+	struct replay_seg *segs;
+	unsigned int nsegs;
+	unsigned int fmax;
+	atomic_t transitions;
+
+	/* results, times in us, energy in kHz * us */
+	u64 time;
+	u64 energy;
+	u64 busy_energy;
+	u64 above_target;
+	u64 backlog;			/* work left over at the end */
+	unsigned int steps;
+	unsigned int unserved_steps;
+	u64 step_delay_total;
+	u64 step_delay_max;
+	bool done;
+};
+
+static DEFINE_MUTEX(replay_mutex);
+static char *replay_trace;		/* trace text as written */
+static size_t replay_trace_len;
+static struct replay_cpu replay_cpus[NR_CPUS];
+static atomic_t replay_running;
+static bool replay_ran;
+
+static inline u64 replay_now_us(void)
+{
+	return div_u64(ktime_to_ns(ktime_get()), NSEC_PER_USEC);
+}
+
+static void replay_sleep_until(u64 until_us)
+{
+	ktime_t t = ns_to_ktime(until_us * NSEC_PER_USEC);
+
+	set_current_state(TASK_INTERRUPTIBLE);
+	schedule_hrtimeout(&t, HRTIMER_MODE_ABS);
+	__set_current_state(TASK_RUNNING);
+}
+
+static void replay_spin_until(u64 until_us)
+{
+	while (replay_now_us() < until_us) {
+		if (kthread_should_stop())
+			return;
+		cpu_relax();
+		cond_resched();
+	}
+}
+
+static void replay_close_step(struct replay_cpu *rc, u64 delay, bool served)
+{
+	if (served) {
+		rc->steps++;
+		rc->step_delay_total += delay;
+		if (delay > rc->step_delay_max)
+			rc->step_delay_max = delay;
+	} else {
+		rc->unserved_steps++;
+	}
+}
+
+static int replay_thread(void *arg)
+{
+	struct replay_cpu *rc = arg;
+	unsigned int i, prev_load = 0, need_freq = 0;
+	u64 work = 0;			/* us of work at fmax still to do */
+	u64 step_start = 0;
+	bool step_open = false;
+
+	for (i = 0; i < rc->nsegs && !kthread_should_stop(); i++) {
+		struct replay_seg *seg = &rc->segs[i];
+		u64 now = replay_now_us();
+		u64 seg_end = now + seg->duration_us;
+
+		if (seg->load >= prev_load + step_pct) {
+			if (step_open)
+				replay_close_step(rc, 0, false);
+			step_open = true;
+			step_start = now;
+			need_freq = min_t(u64, rc->fmax,
+				div_u64((u64)seg->load * rc->fmax,
+					max(target_load, 1U)));
+		}
+		prev_load = seg->load;
+
+		while (now < seg_end && !kthread_should_stop()) {
+			u64 window = min_t(u64, window_us, seg_end - now);
+			u64 need, spin, elapsed;
+			unsigned int freq;
+
+			freq = cpufreq_quick_get(raw_smp_processor_id());
+			if (!freq)
+				freq = rc->fmax;
+
+			if (step_open && freq >= need_freq) {
+				replay_close_step(rc, now - step_start, true);
+				step_open = false;
+			}
+
+			work += div_u64(window * seg->load, 100);
+			need = div_u64(work * rc->fmax, freq);
+			spin = min(need, window);
+
+			replay_spin_until(now + spin);
+			if (spin < window)
+				replay_sleep_until(now + window);
+
+			elapsed = replay_now_us() - now;
+			work -= min(work, div_u64(spin * freq, rc->fmax));
+
+			rc->time += elapsed;
+			rc->energy += (u64)freq * elapsed;
+			rc->busy_energy += (u64)freq * spin;
+			if (need * 100 > (u64)target_load * window)
+				rc->above_target += elapsed;
+			now += elapsed;
+		}
+	}
+	if (step_open)
+		replay_close_step(rc, 0, false);
+	rc->backlog = work;
+	rc->done = true;
+	atomic_dec(&replay_running);
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+	return 0;
+}
+
+static void replay_stop_threads(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct replay_cpu *rc = &replay_cpus[cpu];
+
+		if (rc->task) {
+			kthread_stop(rc->task);
+			rc->task = NULL;
+		}
+		kfree(rc->segs);
+		rc->segs = NULL;
+		rc->nsegs = 0;
+	}
+	atomic_set(&replay_running, 0);
+}
+
+/*
+ * Parse "<cpu> <duration_ms> <load_pct>" lines into per-CPU timelines.
+ */
+static int replay_parse(void)
+{
+	unsigned int counts[NR_CPUS] = { 0 };
+	char *p, *line, *buf;
+	int pass, cpu;
+
+	buf = kmalloc(replay_trace_len + 1, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	for (pass = 0; pass < 2; pass++) {
+		memcpy(buf, replay_trace, replay_trace_len);
+		buf[replay_trace_len] = '\0';
+		p = buf;
+		while ((line = strsep(&p, "\n")) != NULL) {
+			unsigned int c, ms, load;
+			struct replay_cpu *rc;
+
+			line = skip_spaces(line);
+			if (!*line || *line == '#')
+				continue;
+			if (sscanf(line, "%u %u %u", &c, &ms, &load) != 3 ||
+			    c >= nr_cpu_ids || load > 100) {
+				pr_err("cpufreq_replay: bad trace line '%s'\n",
+				       line);
+				kfree(buf);
+				return -EINVAL;
+			}
+			rc = &replay_cpus[c];
+			if (pass == 0) {
+				counts[c]++;
+				continue;
+			}
+			rc->segs[rc->nsegs].duration_us = ms * USEC_PER_MSEC;
+			rc->segs[rc->nsegs].load = load;
+			rc->nsegs++;
+		}
+		if (pass)
+			break;
+		for_each_possible_cpu(cpu) {
+			if (!counts[cpu])
+				continue;
+			replay_cpus[cpu].segs = kcalloc(counts[cpu],
+					sizeof(struct replay_seg), GFP_KERNEL);
+			if (!replay_cpus[cpu].segs) {
+				kfree(buf);
+				return -ENOMEM;
+			}
+		}
+	}
+	kfree(buf);
+	return 0;
+}
+
+static int replay_start(void)
+{
+	struct cpufreq_policy *policy;
+	int cpu, ret, started = 0;
+
+	replay_stop_threads();
+	if (!replay_trace_len)
+		return -ENODATA;
+
+	ret = replay_parse();
+	if (ret)
+		goto fail;
+
+	for_each_possible_cpu(cpu) {
+		struct replay_cpu *rc = &replay_cpus[cpu];
+		struct replay_seg *segs = rc->segs;
+		unsigned int nsegs = rc->nsegs;
+
+		memset(rc, 0, sizeof(*rc));
+		rc->segs = segs;
+		rc->nsegs = nsegs;
+		if (!nsegs)
+			continue;
+
+		policy = cpu_online(cpu) ? cpufreq_cpu_get(cpu) : NULL;
+		if (!policy) {
+			pr_err("cpufreq_replay: cpu%d has no cpufreq policy\n",
+			       cpu);
+			ret = -ENODEV;
+			goto fail;
+		}
+		rc->fmax = policy->cpuinfo.max_freq;
+		cpufreq_cpu_put(policy);
+
+		rc->task = kthread_create(replay_thread, rc, "cfreplay/%d", cpu);
+		if (IS_ERR(rc->task)) {
+			ret = PTR_ERR(rc->task);
+			rc->task = NULL;
+			goto fail;
+		}
+		kthread_bind(rc->task, cpu);
+		started++;
+	}
+
+	atomic_set(&replay_running, started);
+	for_each_possible_cpu(cpu)
+		if (replay_cpus[cpu].task)
+			wake_up_process(replay_cpus[cpu].task);
+	replay_ran = true;
+	return 0;
+
+fail:
+	replay_stop_threads();
+	return ret;
+}
+
+static int replay_transition(struct notifier_block *nb, unsigned long val,
+			     void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+
+	if (val == CPUFREQ_POSTCHANGE && freqs->cpu < NR_CPUS)
+		atomic_inc(&replay_cpus[freqs->cpu].transitions);
+	return 0;
+}
+
+static struct notifier_block replay_transition_nb = {
+	.notifier_call = replay_transition,
+};
+
+static void replay_show_one(struct seq_file *m, const char *name,
+			    struct replay_cpu *rc)
+{
+	u64 time_ms = div_u64(rc->time, USEC_PER_MSEC);
+
+	seq_printf(m, "%s: time_ms=%llu energy_mhz_ms=%llu "
+		   "busy_energy_mhz_ms=%llu avg_mhz=%llu "
+		   "above_target_ms=%llu above_target_pct=%llu "
+		   "steps=%u step_delay_avg_ms=%llu step_delay_max_ms=%llu "
+		   "unserved_steps=%u backlog_ms=%llu transitions=%d\n",
+		   name, time_ms,
+		   div_u64(rc->energy, 1000000),
+		   div_u64(rc->busy_energy, 1000000),
+		   rc->time ? div64_u64(rc->energy, rc->time) / 1000 : 0ULL,
+		   div_u64(rc->above_target, USEC_PER_MSEC),
+		   rc->time ? div64_u64(rc->above_target * 100, rc->time) : 0ULL,
+		   rc->steps,
+		   rc->steps ? div_u64(div_u64(rc->step_delay_total, rc->steps),
+				       USEC_PER_MSEC) : 0ULL,
+		   div_u64(rc->step_delay_max, USEC_PER_MSEC),
+		   rc->unserved_steps,
+		   div_u64(rc->backlog, USEC_PER_MSEC),
+		   atomic_read(&rc->transitions));
+}
+
+static int replay_results_show(struct seq_file *m, void *unused)
+{
+	struct replay_cpu total;
+	struct cpufreq_policy *policy;
+	char name[16];
+	int cpu;
+
+	mutex_lock(&replay_mutex);
+	if (!replay_ran) {
+		seq_printf(m, "idle\n");
+		goto out;
+	}
+	if (atomic_read(&replay_running)) {
+		seq_printf(m, "running\n");
+		goto out;
+	}
+
+	policy = cpufreq_cpu_get(0);
+	seq_printf(m, "governor=%s window_us=%u target_load=%u step_pct=%u\n",
+		   policy && policy->governor ? policy->governor->name : "none",
+		   window_us, target_load, step_pct);
+	if (policy)
+		cpufreq_cpu_put(policy);
+
+	memset(&total, 0, sizeof(total));
+	for_each_possible_cpu(cpu) {
+		struct replay_cpu *rc = &replay_cpus[cpu];
+
+		if (!rc->done)
+			continue;
+		snprintf(name, sizeof(name), "cpu%d", cpu);
+		replay_show_one(m, name, rc);
+
+		total.time += rc->time;
+		total.energy += rc->energy;
+		total.busy_energy += rc->busy_energy;
+		total.above_target += rc->above_target;
+		total.backlog += rc->backlog;
+		total.steps += rc->steps;
+		total.unserved_steps += rc->unserved_steps;
+		total.step_delay_total += rc->step_delay_total;
+		total.step_delay_max = max(total.step_delay_max,
+					   rc->step_delay_max);
+		atomic_add(atomic_read(&rc->transitions), &total.transitions);
+	}
+	replay_show_one(m, "total", &total);
+out:
+	mutex_unlock(&replay_mutex);
+	return 0;
+}
+
+static int replay_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, replay_results_show, NULL);
+}
+
+static const struct file_operations replay_results_fops = {
+	.open		= replay_results_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* A write at offset 0 replaces the trace, later writes append to it. */
+static ssize_t replay_trace_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	ssize_t ret = count;
+
+	mutex_lock(&replay_mutex);
+	if (atomic_read(&replay_running)) {
+		ret = -EBUSY;
+		goto out;
+	}
+	if (*ppos == 0)
+		replay_trace_len = 0;
+	if (replay_trace_len + count > REPLAY_TRACE_MAX) {
+		ret = -EFBIG;
+		goto out;
+	}
+	if (copy_from_user(replay_trace + replay_trace_len, buf, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	replay_trace_len += count;
+	*ppos += count;
+out:
+	mutex_unlock(&replay_mutex);
+	return ret;
+}
+
+static const struct file_operations replay_trace_fops = {
+	.write		= replay_trace_write,
+};
+
+/* "1" starts a replay of the current trace, "0" stops it. */
+static ssize_t replay_run_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul_from_user(buf, count, 0, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&replay_mutex);
+	if (val)
+		ret = replay_start();
+	else
+		replay_stop_threads();
+	mutex_unlock(&replay_mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations replay_run_fops = {
+	.write		= replay_run_write,
+};
+
+static struct dentry *replay_dir;
+
+static int __init cpufreq_replay_init(void)
+{
+	int ret;
+
+	replay_trace = vmalloc(REPLAY_TRACE_MAX);
+	if (!replay_trace)
+		return -ENOMEM;
+
+	replay_dir = debugfs_create_dir("cpufreq_replay", NULL);
+	if (!replay_dir) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+	debugfs_create_file("trace", 0200, replay_dir, NULL,
+			    &replay_trace_fops);
+	debugfs_create_file("run", 0200, replay_dir, NULL, &replay_run_fops);
+	debugfs_create_file("results", 0444, replay_dir, NULL,
+			    &replay_results_fops);
+
+	ret = cpufreq_register_notifier(&replay_transition_nb,
+					CPUFREQ_TRANSITION_NOTIFIER);
+	if (ret)
+		goto err_remove;
+	return 0;
+
+err_remove:
+	debugfs_remove_recursive(replay_dir);
+err_free:
+	vfree(replay_trace);
+	return ret;
+}
+
+static void __exit cpufreq_replay_exit(void)
+{
+	debugfs_remove_recursive(replay_dir);
+	cpufreq_unregister_notifier(&replay_transition_nb,
+				    CPUFREQ_TRANSITION_NOTIFIER);
+	mutex_lock(&replay_mutex);
+	replay_stop_threads();
+	mutex_unlock(&replay_mutex);
+	vfree(replay_trace);
+}
+
+module_init(cpufreq_replay_init);
+module_exit(cpufreq_replay_exit);
+
+MODULE_DESCRIPTION("Load trace replay for cpufreq governor evaluation");
+MODULE_LICENSE("GPL");
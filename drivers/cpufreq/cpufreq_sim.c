@@ -0,0 +1,148 @@
+/*
+ * drivers/cpufreq/cpufreq_sim.c
+ *
+ * Simulated cpufreq driver for governor testing.
+ *
+ * Exposes a synthetic frequency table and accepts every transition the
+ * governor asks for without touching any clock.  Together with
+ * cpufreq_replay this lets governors and their tunables be compared on
+ * machines without frequency scaling, e.g. under QEMU.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/percpu.h>
+
+#define SIM_MAX_FREQS	16
+
+/* msm7x30 acpuclock speeds, in kHz */
+static unsigned int freqs[SIM_MAX_FREQS] = {
+	245760, 368640, 768000, 1024000, 1200000, 1516800,
+};
+static unsigned int nfreqs = 6;
+module_param_array(freqs, uint, &nfreqs, 0444);
+MODULE_PARM_DESC(freqs, "Frequency table (kHz), in ascending order");
+
+static unsigned int latency_us = 60;
+module_param(latency_us, uint, 0444);
+MODULE_PARM_DESC(latency_us, "Advertised transition latency (us)");
+
+static struct cpufreq_frequency_table sim_table[SIM_MAX_FREQS + 1];
+static DEFINE_PER_CPU(unsigned int, sim_cur);
+
+static int sim_cpufreq_verify(struct cpufreq_policy *policy)
+{
+	return cpufreq_frequency_table_verify(policy, sim_table);
+}
+
+static int sim_cpufreq_target(struct cpufreq_policy *policy,
+			      unsigned int target_freq,
+			      unsigned int relation)
+{
+	struct cpufreq_freqs fr;
+	unsigned int index;
+	int ret;
+
+	ret = cpufreq_frequency_table_target(policy, sim_table, target_freq,
+					     relation, &index);
+	if (ret)
+		return ret;
+
+	fr.cpu = policy->cpu;
+	fr.old = per_cpu(sim_cur, policy->cpu);
+	fr.new = sim_table[index].frequency;
+	if (fr.old == fr.new)
+		return 0;
+
+	cpufreq_notify_transition(&fr, CPUFREQ_PRECHANGE);
+	per_cpu(sim_cur, policy->cpu) = fr.new;
+	cpufreq_notify_transition(&fr, CPUFREQ_POSTCHANGE);
+	return 0;
+}
+
+static unsigned int sim_cpufreq_get(unsigned int cpu)
+{
+	return per_cpu(sim_cur, cpu);
+}
+
+static int sim_cpufreq_init(struct cpufreq_policy *policy)
+{
+	int ret;
+
+	ret = cpufreq_frequency_table_cpuinfo(policy, sim_table);
+	if (ret)
+		return ret;
+	cpufreq_frequency_table_get_attr(sim_table, policy->cpu);
+
+	per_cpu(sim_cur, policy->cpu) = sim_table[0].frequency;
+	policy->cur = sim_table[0].frequency;
+	policy->cpuinfo.transition_latency = latency_us * NSEC_PER_USEC;
+	return 0;
+}
+
+static int sim_cpufreq_exit(struct cpufreq_policy *policy)
+{
+	cpufreq_frequency_table_put_attr(policy->cpu);
+	return 0;
+}
+
+static struct freq_attr *sim_cpufreq_attr[] = {
+	&cpufreq_freq_attr_scaling_available_freqs,
+	NULL,
+};
+
+static struct cpufreq_driver sim_cpufreq_driver = {
+	.flags		= CPUFREQ_CONST_LOOPS,
+	.init		= sim_cpufreq_init,
+	.exit		= sim_cpufreq_exit,
+	.verify		= sim_cpufreq_verify,
+	.target		= sim_cpufreq_target,
+	.get		= sim_cpufreq_get,
+	.name		= "sim",
+	.owner		= THIS_MODULE,
+	.attr		= sim_cpufreq_attr,
+};
+
+static int __init sim_cpufreq_register(void)
+{
+	unsigned int i;
+
+	if (!nfreqs)
+		return -EINVAL;
+
+	for (i = 0; i < nfreqs; i++) {
+		if (!freqs[i] || (i && freqs[i] <= freqs[i - 1])) {
+			pr_err("cpufreq_sim: freqs must be ascending and non-zero\n");
+			return -EINVAL;
+		}
+		sim_table[i].index = i;
+		sim_table[i].frequency = freqs[i];
+	}
+	sim_table[i].index = i;
+	sim_table[i].frequency = CPUFREQ_TABLE_END;
+
+	return cpufreq_register_driver(&sim_cpufreq_driver);
+}
+
+static void __exit sim_cpufreq_unregister(void)
+{
+	cpufreq_unregister_driver(&sim_cpufreq_driver);
+}
+
+module_init(sim_cpufreq_register);
+module_exit(sim_cpufreq_unregister);
+
+MODULE_DESCRIPTION("Simulated cpufreq driver for governor testing");
+MODULE_LICENSE("GPL");
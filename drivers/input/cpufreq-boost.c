@@ -0,0 +1,273 @@
+/*
+ *  Input Event -> CPU frequency boost
+ *
+ *  Boosts the CPU speed through cpufreq_boost() as soon as the user
+ *  touches the screen or presses a key, rather than waiting for
+ *  userspace to see the event and write the governor's boostpulse.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/input.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+static unsigned int boost_freq;
+module_param(boost_freq, uint, 0644);
+MODULE_PARM_DESC(boost_freq, "Frequency to boost to (kHz), 0 for the governor's hispeed_freq");
+
+static unsigned int boost_ms;
+module_param(boost_ms, uint, 0644);
+MODULE_PARM_DESC(boost_ms, "Boost duration (ms), 0 for the governor's boostpulse_duration");
+
+static unsigned int min_interval_ms = 40;
+module_param(min_interval_ms, uint, 0644);
+MODULE_PARM_DESC(min_interval_ms, "Minimum time between two boosts (ms)");
+
+static DEFINE_SPINLOCK(cfboost_lock);
+static u64 cfboost_last_ns;		/* last boost */
+static u64 cfboost_pending_ns;		/* boost not yet seen to raise speed */
+
+static struct cfboost_stats {
+	unsigned long boosts;
+	unsigned long rate_limited;
+	unsigned long freq_raised;	/* boosts followed by a speed increase */
+	unsigned long no_change;	/* boosts the speed was already up for */
+	u64 lat_total_ns;		/* input event to speed increase */
+	u64 lat_max_ns;
+	u64 lat_last_ns;
+} cfboost_stats;
+
+static u64 cfboost_now(void)
+{
+	struct timespec ts;
+
+	ktime_get_ts(&ts);
+	return timespec_to_ns(&ts);
+}
+
+static void cfboost_event(struct input_handle *handle, unsigned int type,
+			  unsigned int code, int value)
+{
+	unsigned long flags;
+	u64 now;
+
+	/* key down and touch contact/motion only */
+	if (type == EV_KEY ? value != 1 : type != EV_ABS)
+		return;
+
+	now = cfboost_now();
+
+	spin_lock_irqsave(&cfboost_lock, flags);
+	if (cfboost_last_ns &&
+	    now - cfboost_last_ns < (u64)min_interval_ms * NSEC_PER_MSEC) {
+		cfboost_stats.rate_limited++;
+		spin_unlock_irqrestore(&cfboost_lock, flags);
+		return;
+	}
+	if (cfboost_pending_ns)
+		cfboost_stats.no_change++;
+	cfboost_last_ns = now;
+	cfboost_pending_ns = now;
+	cfboost_stats.boosts++;
+	spin_unlock_irqrestore(&cfboost_lock, flags);
+
+	cpufreq_boost(boost_freq, boost_ms * USEC_PER_MSEC);
+}
+
+static int cfboost_transition(struct notifier_block *nb, unsigned long val,
+			      void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+	unsigned long flags;
+	u64 lat;
+
+	if (val != CPUFREQ_POSTCHANGE || freqs->new <= freqs->old)
+		return 0;
+
+	spin_lock_irqsave(&cfboost_lock, flags);
+	if (cfboost_pending_ns) {
+		lat = cfboost_now() - cfboost_pending_ns;
+		cfboost_pending_ns = 0;
+		cfboost_stats.freq_raised++;
+		cfboost_stats.lat_total_ns += lat;
+		cfboost_stats.lat_last_ns = lat;
+		if (lat > cfboost_stats.lat_max_ns)
+			cfboost_stats.lat_max_ns = lat;
+	}
+	spin_unlock_irqrestore(&cfboost_lock, flags);
+	return 0;
+}
+
+static struct notifier_block cfboost_transition_nb = {
+	.notifier_call = cfboost_transition,
+};
+
+static int cfboost_connect(struct input_handler *handler,
+			   struct input_dev *dev,
+			   const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq-boost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free_handle;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister_handle;
+
+	return 0;
+
+err_unregister_handle:
+	input_unregister_handle(handle);
+err_free_handle:
+	kfree(handle);
+	return error;
+}
+
+static void cfboost_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id cfboost_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	}, /* multi-touch touchscreen */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	}, /* touchpad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	}, /* keys */
+	{ },
+};
+
+MODULE_DEVICE_TABLE(input, cfboost_ids);
+
+static struct input_handler cfboost_handler = {
+	.event		= cfboost_event,
+	.connect	= cfboost_connect,
+	.disconnect	= cfboost_disconnect,
+	.name		= "cpufreq-boost",
+	.id_table	= cfboost_ids,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int cfboost_stats_show(struct seq_file *m, void *unused)
+{
+	struct cfboost_stats st;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cfboost_lock, flags);
+	st = cfboost_stats;
+	spin_unlock_irqrestore(&cfboost_lock, flags);
+
+	seq_printf(m, "boosts: %lu\n", st.boosts);
+	seq_printf(m, "rate_limited: %lu\n", st.rate_limited);
+	seq_printf(m, "freq_raised: %lu\n", st.freq_raised);
+	seq_printf(m, "no_change: %lu\n", st.no_change);
+	seq_printf(m, "latency_avg_us: %llu\n", st.freq_raised ?
+		   div_u64(div_u64(st.lat_total_ns, st.freq_raised),
+			   NSEC_PER_USEC) : 0ULL);
+	seq_printf(m, "latency_max_us: %llu\n",
+		   div_u64(st.lat_max_ns, NSEC_PER_USEC));
+	seq_printf(m, "latency_last_us: %llu\n",
+		   div_u64(st.lat_last_ns, NSEC_PER_USEC));
+	return 0;
+}
+
+static int cfboost_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cfboost_stats_show, NULL);
+}
+
+static const struct file_operations cfboost_stats_fops = {
+	.open		= cfboost_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct dentry *cfboost_dentry;
+
+static void cfboost_debugfs_init(void)
+{
+	cfboost_dentry = debugfs_create_file("cpufreq_boost", 0444, NULL,
+					     NULL, &cfboost_stats_fops);
+}
+
+static void cfboost_debugfs_exit(void)
+{
+	debugfs_remove(cfboost_dentry);
+}
+#else
+static inline void cfboost_debugfs_init(void) { }
+static inline void cfboost_debugfs_exit(void) { }
+#endif
+
+static int __init cfboost_init(void)
+{
+	int error;
+
+	error = cpufreq_register_notifier(&cfboost_transition_nb,
+					  CPUFREQ_TRANSITION_NOTIFIER);
+	if (error)
+		return error;
+
+	error = input_register_handler(&cfboost_handler);
+	if (error) {
+		cpufreq_unregister_notifier(&cfboost_transition_nb,
+					    CPUFREQ_TRANSITION_NOTIFIER);
+		return error;
+	}
+
+	cfboost_debugfs_init();
+	return 0;
+}
+
+static void __exit cfboost_exit(void)
+{
+	cfboost_debugfs_exit();
+	input_unregister_handler(&cfboost_handler);
+	cpufreq_unregister_notifier(&cfboost_transition_nb,
+				    CPUFREQ_TRANSITION_NOTIFIER);
+}
+
+module_init(cfboost_init);
+module_exit(cfboost_exit);
+
+MODULE_DESCRIPTION("Input event to CPU frequency boost bridge");
+MODULE_LICENSE("GPL");
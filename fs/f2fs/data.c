@@ -23,6 +23,8 @@
 #include "segment.h"
 #include <trace/events/f2fs.h>
 
+static struct kmem_cache *extent_node_slab;
+
 static void f2fs_read_end_io(struct bio *bio, int err)
 {
 	struct bio_vec *bvec;
@@ -266,47 +268,296 @@ int f2fs_reserve_block(struct dnode_of_data *dn, pgoff_t index)
 	return err;
 }
 
-static int check_extent_cache(struct inode *inode, pgoff_t pgofs,
-					struct buffer_head *bh_result)
+/*
+ * The extent tree caches every contiguous range of file offsets that was
+ * resolved through the node pages, so that a mapping is walked only once while
+ * it stays unchanged.  The largest extent is still kept in fi->ext and stored
+ * in the on-disk inode; the tree itself lives only in memory.
+ *
+ * Every update of a data block address goes through update_extent_cache(),
+ * which drops the old mapping from the tree and bumps et->gen.  Readers take a
+ * snapshot of et->gen before walking the node pages and only cache what they
+ * found if no update has happened in between.
+ */
+static struct extent_node *__lookup_extent_node(struct extent_tree *et,
+							unsigned int fofs)
 {
-	struct f2fs_inode_info *fi = F2FS_I(inode);
-	pgoff_t start_fofs, end_fofs;
-	block_t start_blkaddr;
+	struct rb_node *node = et->root.rb_node;
+
+	while (node) {
+		struct extent_node *en = rb_entry(node, struct extent_node,
+								rb_node);
+		if (fofs < en->fofs)
+			node = node->rb_left;
+		else if (fofs >= en->fofs + en->len)
+			node = node->rb_right;
+		else
+			return en;
+	}
+	return NULL;
+}
 
-	if (is_inode_flag_set(fi, FI_NO_EXTENT))
-		return 0;
+/* Find the first extent node ending beyond fofs */
+static struct extent_node *__first_extent_node(struct extent_tree *et,
+							unsigned int fofs)
+{
+	struct rb_node *node = et->root.rb_node;
+	struct extent_node *found = NULL;
+
+	while (node) {
+		struct extent_node *en = rb_entry(node, struct extent_node,
+								rb_node);
+		if (en->fofs + en->len <= fofs) {
+			node = node->rb_right;
+		} else {
+			found = en;
+			node = node->rb_left;
+		}
+	}
+	return found;
+}
 
-	read_lock(&fi->ext.ext_lock);
-	if (fi->ext.len == 0) {
-		read_unlock(&fi->ext.ext_lock);
-		return 0;
+static struct extent_node *__attach_extent_node(struct super_block *sb,
+		struct extent_tree *et, struct rb_node *parent,
+		struct rb_node **p, unsigned int fofs, u32 blk_addr,
+		unsigned int len)
+{
+	struct extent_node *en;
+
+	en = kmem_cache_alloc(extent_node_slab, GFP_ATOMIC);
+	if (!en)
+		return NULL;
+
+	en->fofs = fofs;
+	en->blk_addr = blk_addr;
+	en->len = len;
+	rb_link_node(&en->rb_node, parent, p);
+	rb_insert_color(&en->rb_node, &et->root);
+	et->count++;
+	stat_inc_ext_node(sb);
+	return en;
+}
+
+static void __detach_extent_node(struct super_block *sb,
+			struct extent_tree *et, struct extent_node *en)
+{
+	rb_erase(&en->rb_node, &et->root);
+	kmem_cache_free(extent_node_slab, en);
+	et->count--;
+	stat_dec_ext_node(sb);
+}
+
+static void __free_extent_tree(struct super_block *sb, struct extent_tree *et)
+{
+	struct rb_node *node;
+
+	while ((node = rb_first(&et->root)))
+		__detach_extent_node(sb, et,
+				rb_entry(node, struct extent_node, rb_node));
+}
+
+/*
+ * Insert [fofs, fofs + len) -> blk_addr which must not overlap any node in
+ * the tree, merging it with its neighbours when they are contiguous.
+ */
+static void __insert_extent_node(struct super_block *sb,
+		struct extent_tree *et, unsigned int fofs, u32 blk_addr,
+		unsigned int len)
+{
+	struct rb_node **p = &et->root.rb_node, *parent = NULL;
+	struct extent_node *en, *prev = NULL, *next = NULL;
+
+	while (*p) {
+		parent = *p;
+		en = rb_entry(parent, struct extent_node, rb_node);
+		if (fofs < en->fofs) {
+			next = en;
+			p = &parent->rb_left;
+		} else {
+			prev = en;
+			p = &parent->rb_right;
+		}
 	}
 
-	stat_inc_total_hit(inode->i_sb);
+	if (prev && prev->fofs + prev->len == fofs &&
+			prev->blk_addr + prev->len == blk_addr) {
+		prev->len += len;
+		if (next && fofs + len == next->fofs &&
+				blk_addr + len == next->blk_addr) {
+			prev->len += next->len;
+			__detach_extent_node(sb, et, next);
+		}
+		return;
+	}
 
-	start_fofs = fi->ext.fofs;
-	end_fofs = fi->ext.fofs + fi->ext.len - 1;
-	start_blkaddr = fi->ext.blk_addr;
+	if (next && fofs + len == next->fofs &&
+			blk_addr + len == next->blk_addr) {
+		next->fofs = fofs;
+		next->blk_addr = blk_addr;
+		next->len += len;
+		return;
+	}
 
-	if (pgofs >= start_fofs && pgofs <= end_fofs) {
-		unsigned int blkbits = inode->i_sb->s_blocksize_bits;
-		size_t count;
+	/* Too fragmented to be worth caching; start over */
+	if (et->count >= F2FS_MAX_EXTENT_NODES) {
+		__free_extent_tree(sb, et);
+		p = &et->root.rb_node;
+		parent = NULL;
+	}
+	__attach_extent_node(sb, et, parent, p, fofs, blk_addr, len);
+}
 
-		clear_buffer_new(bh_result);
-		map_bh(bh_result, inode->i_sb,
-				start_blkaddr + pgofs - start_fofs);
-		count = end_fofs - pgofs + 1;
-		if (count < (UINT_MAX >> blkbits))
-			bh_result->b_size = (count << blkbits);
-		else
-			bh_result->b_size = UINT_MAX;
+/* Forget the mapping of [fofs, fofs + len) */
+static void __remove_extent_range(struct super_block *sb,
+		struct extent_tree *et, unsigned int fofs, unsigned int len)
+{
+	unsigned int end = fofs + len;
+	struct extent_node *en;
+
+	while ((en = __first_extent_node(et, fofs)) && en->fofs < end) {
+		unsigned int en_end = en->fofs + en->len;
+		u32 en_blk_addr = en->blk_addr;
+
+		if (en->fofs < fofs) {
+			/* keep the front part */
+			en->len = fofs - en->fofs;
+			if (en_end > end) {
+				/* and the back part as a new node */
+				__insert_extent_node(sb, et, end,
+					en_blk_addr + end - en->fofs,
+					en_end - end);
+				return;
+			}
+		} else if (en_end > end) {
+			en->blk_addr += end - en->fofs;
+			en->len = en_end - end;
+			en->fofs = end;
+			return;
+		} else {
+			__detach_extent_node(sb, et, en);
+		}
+	}
+}
+
+static bool lookup_extent_tree(struct inode *inode, pgoff_t pgofs,
+				block_t *blk_addr, unsigned int *len)
+{
+	struct extent_tree *et = &F2FS_I(inode)->ext_tree;
+	struct extent_node *en;
+	bool found = false;
+
+	read_lock(&et->lock);
+	en = __lookup_extent_node(et, pgofs);
+	if (en) {
+		*blk_addr = en->blk_addr + pgofs - en->fofs;
+		*len = en->fofs + en->len - pgofs;
+		found = true;
+	}
+	read_unlock(&et->lock);
+	return found;
+}
+
+static unsigned int extent_tree_gen(struct inode *inode)
+{
+	struct extent_tree *et = &F2FS_I(inode)->ext_tree;
+	unsigned int gen;
+
+	read_lock(&et->lock);
+	gen = et->gen;
+	read_unlock(&et->lock);
+	return gen;
+}
+
+/* Cache a mapping found in the node pages, unless it changed meanwhile */
+static void cache_extent_tree(struct inode *inode, pgoff_t fofs,
+		block_t blk_addr, unsigned int len, unsigned int gen)
+{
+	struct extent_tree *et = &F2FS_I(inode)->ext_tree;
+
+	if (blk_addr == NULL_ADDR || blk_addr == NEW_ADDR)
+		return;
+
+	write_lock(&et->lock);
+	if (et->gen == gen) {
+		__remove_extent_range(inode->i_sb, et, fofs, len);
+		__insert_extent_node(inode->i_sb, et, fofs, blk_addr, len);
+	}
+	write_unlock(&et->lock);
+}
 
-		stat_inc_read_hit(inode->i_sb);
+static void update_extent_tree(struct inode *inode, pgoff_t fofs,
+							block_t blk_addr)
+{
+	struct extent_tree *et = &F2FS_I(inode)->ext_tree;
+
+	write_lock(&et->lock);
+	et->gen++;
+	__remove_extent_range(inode->i_sb, et, fofs, 1);
+	if (blk_addr != NULL_ADDR)
+		__insert_extent_node(inode->i_sb, et, fofs, blk_addr, 1);
+	write_unlock(&et->lock);
+}
+
+void f2fs_drop_extent_tree(struct inode *inode)
+{
+	struct extent_tree *et = &F2FS_I(inode)->ext_tree;
+
+	write_lock(&et->lock);
+	et->gen++;
+	__free_extent_tree(inode->i_sb, et);
+	write_unlock(&et->lock);
+}
+
+/*
+ * Look pgofs up in the largest extent first and then in the extent tree.
+ * On a hit, *len is the number of contiguous blocks mapped from pgofs.
+ */
+static bool lookup_extent_cache(struct inode *inode, pgoff_t pgofs,
+				block_t *blk_addr, unsigned int *len)
+{
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+
+	stat_inc_total_hit(inode->i_sb);
+
+	if (!is_inode_flag_set(fi, FI_NO_EXTENT)) {
+		read_lock(&fi->ext.ext_lock);
+		if (fi->ext.len && pgofs >= fi->ext.fofs &&
+				pgofs < fi->ext.fofs + fi->ext.len) {
+			*blk_addr = fi->ext.blk_addr + pgofs - fi->ext.fofs;
+			*len = fi->ext.fofs + fi->ext.len - pgofs;
+			read_unlock(&fi->ext.ext_lock);
+			stat_inc_read_hit(inode->i_sb);
+			return true;
+		}
 		read_unlock(&fi->ext.ext_lock);
-		return 1;
 	}
-	read_unlock(&fi->ext.ext_lock);
-	return 0;
+
+	if (lookup_extent_tree(inode, pgofs, blk_addr, len)) {
+		stat_inc_tree_hit(inode->i_sb);
+		return true;
+	}
+
+	stat_inc_miss_ext(inode->i_sb);
+	return false;
+}
+
+static int check_extent_cache(struct inode *inode, pgoff_t pgofs,
+					struct buffer_head *bh_result)
+{
+	unsigned int blkbits = inode->i_sb->s_blocksize_bits;
+	block_t blk_addr;
+	unsigned int count;
+
+	if (!lookup_extent_cache(inode, pgofs, &blk_addr, &count))
+		return 0;
+
+	clear_buffer_new(bh_result);
+	map_bh(bh_result, inode->i_sb, blk_addr);
+	if (count < (UINT_MAX >> blkbits))
+		bh_result->b_size = (count << blkbits);
+	else
+		bh_result->b_size = UINT_MAX;
+	return 1;
 }
 
 void update_extent_cache(block_t blk_addr, struct dnode_of_data *dn)
@@ -323,6 +574,8 @@ void update_extent_cache(block_t blk_addr, struct dnode_of_data *dn)
 	/* Update the page address in the parent node */
 	__set_data_blkaddr(dn, blk_addr);
 
+	update_extent_tree(dn->inode, fofs, blk_addr);
+
 	if (is_inode_flag_set(fi, FI_NO_EXTENT))
 		return;
 
@@ -389,12 +642,38 @@ end_update:
 	return;
 }
 
+/*
+ * Resolve the block address of index through the extent cache, falling back
+ * to the node pages and caching what was found there.
+ */
+static int lookup_data_blkaddr(struct inode *inode, pgoff_t index,
+							block_t *blk_addr)
+{
+	struct dnode_of_data dn;
+	unsigned int len, gen;
+	int err;
+
+	if (lookup_extent_cache(inode, index, blk_addr, &len))
+		return 0;
+
+	gen = extent_tree_gen(inode);
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, index, LOOKUP_NODE);
+	if (err)
+		return err;
+	f2fs_put_dnode(&dn);
+
+	*blk_addr = dn.data_blkaddr;
+	cache_extent_tree(inode, index, *blk_addr, 1, gen);
+	return 0;
+}
+
 struct page *find_data_page(struct inode *inode, pgoff_t index, bool sync)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
 	struct address_space *mapping = inode->i_mapping;
-	struct dnode_of_data dn;
 	struct page *page;
+	block_t blk_addr;
 	int err;
 
 	page = find_get_page(mapping, index);
@@ -402,17 +681,15 @@ struct page *find_data_page(struct inode *inode, pgoff_t index, bool sync)
 		return page;
 	f2fs_put_page(page, 0);
 
-	set_new_dnode(&dn, inode, NULL, NULL, 0);
-	err = get_dnode_of_data(&dn, index, LOOKUP_NODE);
+	err = lookup_data_blkaddr(inode, index, &blk_addr);
 	if (err)
 		return ERR_PTR(err);
-	f2fs_put_dnode(&dn);
 
-	if (dn.data_blkaddr == NULL_ADDR)
+	if (blk_addr == NULL_ADDR)
 		return ERR_PTR(-ENOENT);
 
 	/* By fallocate(), there is no cached page, but with NEW_ADDR */
-	if (unlikely(dn.data_blkaddr == NEW_ADDR))
+	if (unlikely(blk_addr == NEW_ADDR))
 		return ERR_PTR(-EINVAL);
 
 	page = grab_cache_page(mapping, index);
@@ -424,7 +701,7 @@ struct page *find_data_page(struct inode *inode, pgoff_t index, bool sync)
 		return page;
 	}
 
-	err = f2fs_submit_page_bio(sbi, page, dn.data_blkaddr,
+	err = f2fs_submit_page_bio(sbi, page, blk_addr,
 					sync ? READ_SYNC : READA);
 	if (err)
 		return ERR_PTR(err);
@@ -448,8 +725,8 @@ struct page *get_lock_data_page(struct inode *inode, pgoff_t index)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
 	struct address_space *mapping = inode->i_mapping;
-	struct dnode_of_data dn;
 	struct page *page;
+	block_t blk_addr;
 	int err;
 
 repeat:
@@ -457,15 +734,13 @@ repeat:
 	if (!page)
 		return ERR_PTR(-ENOMEM);
 
-	set_new_dnode(&dn, inode, NULL, NULL, 0);
-	err = get_dnode_of_data(&dn, index, LOOKUP_NODE);
+	err = lookup_data_blkaddr(inode, index, &blk_addr);
 	if (err) {
 		f2fs_put_page(page, 1);
 		return ERR_PTR(err);
 	}
-	f2fs_put_dnode(&dn);
 
-	if (unlikely(dn.data_blkaddr == NULL_ADDR)) {
+	if (unlikely(blk_addr == NULL_ADDR)) {
 		f2fs_put_page(page, 1);
 		return ERR_PTR(-ENOENT);
 	}
@@ -479,13 +754,13 @@ repeat:
 	 * In such the case, its blkaddr can be remained as NEW_ADDR.
 	 * see, f2fs_add_link -> get_new_data_page -> init_inode_metadata.
 	 */
-	if (dn.data_blkaddr == NEW_ADDR) {
+	if (blk_addr == NEW_ADDR) {
 		zero_user_segment(page, 0, PAGE_CACHE_SIZE);
 		SetPageUptodate(page);
 		return page;
 	}
 
-	err = f2fs_submit_page_bio(sbi, page, dn.data_blkaddr, READ_SYNC);
+	err = f2fs_submit_page_bio(sbi, page, blk_addr, READ_SYNC);
 	if (err)
 		return ERR_PTR(err);
 
@@ -614,7 +889,8 @@ static int get_data_block(struct inode *inode, sector_t iblock,
 	unsigned maxblocks = bh_result->b_size >> blkbits;
 	struct dnode_of_data dn;
 	int mode = create ? ALLOC_NODE : LOOKUP_NODE_RA;
-	pgoff_t pgofs, end_offset;
+	pgoff_t pgofs, start_pgofs, end_offset;
+	unsigned int gen;
 	int err = 0, ofs = 1;
 	bool allocated = false;
 
@@ -624,6 +900,9 @@ static int get_data_block(struct inode *inode, sector_t iblock,
 	if (check_extent_cache(inode, pgofs, bh_result))
 		goto out;
 
+	start_pgofs = pgofs;
+	gen = extent_tree_gen(inode);
+
 	if (create)
 		f2fs_lock_op(sbi);
 
@@ -698,6 +977,9 @@ sync_out:
 		sync_inode_page(&dn);
 put_out:
 	f2fs_put_dnode(&dn);
+	if (!create && buffer_mapped(bh_result))
+		cache_extent_tree(inode, start_pgofs, bh_result->b_blocknr,
+					bh_result->b_size >> blkbits, gen);
 unlock_out:
 	if (create)
 		f2fs_unlock_op(sbi);
@@ -706,6 +988,20 @@ out:
 	return err;
 }
 
+int __init create_extent_cache(void)
+{
+	extent_node_slab = f2fs_kmem_cache_create("f2fs_extent_node",
+					sizeof(struct extent_node));
+	if (!extent_node_slab)
+		return -ENOMEM;
+	return 0;
+}
+
+void destroy_extent_cache(void)
+{
+	kmem_cache_destroy(extent_node_slab);
+}
+
 int f2fs_fiemap(struct inode *inode, struct fiemap_extent_info *fieinfo,
 		u64 start, u64 len)
 {
@@ -759,6 +1055,10 @@ int do_write_data_page(struct page *page, struct f2fs_io_info *fio)
 
 	set_page_writeback(page);
 
+	/* GC moves are not updates by users */
+	if (old_blkaddr != NEW_ADDR && !is_cold_data(page))
+		file_inc_hotness(inode);
+
 	/*
 	 * If current allocation needs SSR,
 	 * it had better in-place writes for updated data.
@@ -35,6 +35,9 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	/* valid check of the segment numbers */
 	si->hit_ext = sbi->read_hit_ext;
 	si->total_ext = sbi->total_hit_ext;
+	si->tree_hit_ext = sbi->tree_hit_ext;
+	si->miss_ext = sbi->miss_ext;
+	si->ext_node = atomic_read(&sbi->total_ext_node);
 	si->ndirty_node = get_pages(sbi, F2FS_DIRTY_NODES);
 	si->ndirty_dent = get_pages(sbi, F2FS_DIRTY_DENTS);
 	si->ndirty_dirs = sbi->n_dirty_dirs;
@@ -77,6 +80,22 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 		si->segment_count[i] = sbi->segment_count[i];
 		si->block_count[i] = sbi->block_count[i];
 	}
+
+	for (i = 0; i < NR_CURSEG_DATA_TYPE; i++) {
+		si->data_type_blks[i] = sbi->data_type_blks[i];
+		si->gc_type_blks[i] = sbi->gc_type_blks[i];
+	}
+
+	if (SM_I(sbi)->dcc_info) {
+		struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+		si->nr_discard_cmds = dcc->nr_cmds;
+		si->nr_pending_discards = dcc->nr_pending;
+		si->issued_discards = dcc->issued_cmds;
+		si->issued_discard_blks = dcc->issued_blks;
+		si->merged_discards = dcc->merged_cmds;
+		si->cancelled_discard_blks = dcc->cancelled_blks;
+	}
 }
 
 /*
@@ -169,6 +188,8 @@ get_cache:
 	si->cache_mem += npages << PAGE_CACHE_SHIFT;
 	si->cache_mem += sbi->n_orphans * sizeof(struct orphan_inode_entry);
 	si->cache_mem += sbi->n_dirty_dirs * sizeof(struct dir_inode_entry);
+	si->cache_mem += atomic_read(&sbi->total_ext_node) *
+						sizeof(struct extent_node);
 }
 
 static int stat_show(struct seq_file *s, void *v)
@@ -242,7 +263,10 @@ static int stat_show(struct seq_file *s, void *v)
 		seq_printf(s, "  - data blocks : %d\n", si->data_blks);
 		seq_printf(s, "  - node blocks : %d\n", si->node_blks);
 		seq_printf(s, "\nExtent Hit Ratio: %d / %d\n",
-			   si->hit_ext, si->total_ext);
+			   si->hit_ext + si->tree_hit_ext, si->total_ext);
+		seq_printf(s, "  - largest: %d, tree: %d, miss: %d\n",
+			   si->hit_ext, si->tree_hit_ext, si->miss_ext);
+		seq_printf(s, "  - tree nodes: %d\n", si->ext_node);
 		seq_puts(s, "\nBalancing F2FS Async:\n");
 		seq_printf(s, "  - nodes: %4d in %4d\n",
 			   si->ndirty_node, si->node_pages);
@@ -274,6 +298,28 @@ static int stat_show(struct seq_file *s, void *v)
 		seq_printf(s, "LFS: %u blocks in %u segments\n",
 			   si->block_count[LFS], si->segment_count[LFS]);
 
+		seq_puts(s, "\nData blocks [ hot | warm | cold ]\n");
+		seq_printf(s, "  - written: %u | %u | %u\n",
+			   si->data_type_blks[CURSEG_HOT_DATA],
+			   si->data_type_blks[CURSEG_WARM_DATA],
+			   si->data_type_blks[CURSEG_COLD_DATA]);
+		seq_printf(s, "  - moved by GC: %u | %u | %u\n",
+			   si->gc_type_blks[CURSEG_HOT_DATA],
+			   si->gc_type_blks[CURSEG_WARM_DATA],
+			   si->gc_type_blks[CURSEG_COLD_DATA]);
+
+		if (SM_I(si->sbi)->dcc_info) {
+			seq_printf(s, "\nDiscard: %u cmds pending (%u blocks)\n",
+				   si->nr_discard_cmds,
+				   si->nr_pending_discards);
+			seq_printf(s, "  - issued: %llu cmds (%llu blocks)\n",
+				   si->issued_discards,
+				   si->issued_discard_blks);
+			seq_printf(s, "  - merged: %llu, cancelled: %llu blocks\n",
+				   si->merged_discards,
+				   si->cancelled_discard_blks);
+		}
+
 		/* segment usage info */
 		update_sit_info(si->sbi);
 		seq_printf(s, "\nBDF: %u, avg. vblocks: %u\n",
@@ -194,6 +194,23 @@ struct extent_info {
 	unsigned int len;	/* lenth of the extent */
 };
 
+/* for in-memory extent tree */
+#define F2FS_MAX_EXTENT_NODES	256	/* maximum extent nodes per inode */
+
+struct extent_node {
+	struct rb_node rb_node;	/* rb node located in extent tree */
+	unsigned int fofs;	/* start offset in a file */
+	u32 blk_addr;		/* start block address of the extent */
+	unsigned int len;	/* length of the extent */
+};
+
+struct extent_tree {
+	rwlock_t lock;		/* protect the extent tree */
+	struct rb_root root;	/* root of extent nodes sorted by fofs */
+	unsigned int count;	/* # of extent nodes in the tree */
+	unsigned int gen;	/* bumped on every block address update */
+};
+
 /*
  * i_advise uses FADVISE_XXX_BIT. We can add additional hints later.
  */
@@ -220,7 +237,10 @@ struct f2fs_inode_info {
 	nid_t i_xattr_nid;		/* node id that contains xattrs */
 	unsigned long long xattr_ver;	/* cp version of xattr modification */
 	struct extent_info ext;		/* in-memory extent cache entry */
+	struct extent_tree ext_tree;	/* in-memory extent tree */
 	struct dir_inode_entry *dirty_dir;	/* the pointer of dirty dir */
+	unsigned int i_hotness;		/* # of recently rewritten blocks */
+	unsigned long i_hotness_stamp;	/* last decay time of i_hotness */
 };
 
 static inline void get_extent_info(struct extent_info *ext,
@@ -336,6 +356,30 @@ struct flush_cmd_control {
 	struct flush_cmd *issue_tail;		/* list tail of issue list */
 };
 
+struct discard_cmd {
+	struct list_head list;		/* linked in address order */
+	block_t blkaddr;		/* start block address of the discard */
+	block_t len;			/* # of consecutive blocks */
+};
+
+struct discard_cmd_control {
+	struct task_struct *f2fs_issue_discard;	/* discard thread */
+	wait_queue_head_t discard_wait_queue;	/* waiting queue for wake-up */
+	wait_queue_head_t issue_wait_queue;	/* waiting for in-flight discard */
+	struct mutex cmd_lock;			/* for pending cmds */
+	struct list_head cmd_list;		/* pending cmds */
+	unsigned long *pend_segmap;		/* segments having pending cmds */
+	block_t issue_blkaddr;			/* in-flight discard address */
+	block_t issue_len;			/* in-flight discard length */
+
+	unsigned int nr_cmds;			/* # of pending cmds */
+	block_t nr_pending;			/* # of pending blocks */
+	unsigned long long issued_cmds;		/* # of issued cmds */
+	unsigned long long issued_blks;		/* # of issued blocks */
+	unsigned long long merged_cmds;		/* # of merged cmds */
+	unsigned long long cancelled_blks;	/* # of cancelled blocks */
+};
+
 struct f2fs_sm_info {
 	struct sit_info *sit_info;		/* whole segment information */
 	struct free_segmap_info *free_info;	/* free segment information */
@@ -367,6 +411,12 @@ struct f2fs_sm_info {
 
 	/* for flush command control */
 	struct flush_cmd_control *cmd_control_info;
+
+	/* for discard command control */
+	struct discard_cmd_control *dcc_info;
+	unsigned int max_pending_discards;	/* issue even if not idle */
+
+	unsigned int hot_data_thresh;	/* hotness of files for hot data log */
 };
 
 /*
@@ -502,7 +552,12 @@ struct f2fs_sb_info {
 	struct f2fs_stat_info *stat_info;	/* FS status information */
 	unsigned int segment_count[2];		/* # of allocated segments */
 	unsigned int block_count[2];		/* # of allocated blocks */
+	/* # of data blocks written by users and moved by GC per log type */
+	unsigned int data_type_blks[NR_CURSEG_DATA_TYPE];
+	unsigned int gc_type_blks[NR_CURSEG_DATA_TYPE];
 	int total_hit_ext, read_hit_ext;	/* extent cache hit ratio */
+	int tree_hit_ext, miss_ext;		/* extent tree hits and misses */
+	atomic_t total_ext_node;		/* # of cached extent nodes */
 	int inline_inode;			/* # of inline_data inodes */
 	int bg_gc;				/* background gc calls */
 	unsigned int n_dirty_dirs;		/* # of dir inodes */
@@ -1194,6 +1249,10 @@ void f2fs_balance_fs_bg(struct f2fs_sb_info *);
 int f2fs_issue_flush(struct f2fs_sb_info *);
 int create_flush_cmd_control(struct f2fs_sb_info *);
 void destroy_flush_cmd_control(struct f2fs_sb_info *);
+int start_discard_thread(struct f2fs_sb_info *);
+void stop_discard_thread(struct f2fs_sb_info *);
+int create_discard_cmd_control(struct f2fs_sb_info *);
+void destroy_discard_cmd_control(struct f2fs_sb_info *);
 void invalidate_blocks(struct f2fs_sb_info *, block_t);
 void refresh_sit_entry(struct f2fs_sb_info *, block_t, block_t);
 void clear_prefree_segments(struct f2fs_sb_info *);
@@ -1256,11 +1315,14 @@ void f2fs_submit_page_mbio(struct f2fs_sb_info *, struct page *, block_t,
 int reserve_new_block(struct dnode_of_data *);
 int f2fs_reserve_block(struct dnode_of_data *, pgoff_t);
 void update_extent_cache(block_t, struct dnode_of_data *);
+void f2fs_drop_extent_tree(struct inode *);
 struct page *find_data_page(struct inode *, pgoff_t, bool);
 struct page *get_lock_data_page(struct inode *, pgoff_t);
 struct page *get_new_data_page(struct inode *, struct page *, pgoff_t, bool);
 int do_write_data_page(struct page *, struct f2fs_io_info *);
 int f2fs_fiemap(struct inode *inode, struct fiemap_extent_info *, u64, u64);
+int __init create_extent_cache(void);
+void destroy_extent_cache(void);
 
 /*
  * gc.c
@@ -1289,7 +1351,7 @@ struct f2fs_stat_info {
 	struct mutex stat_lock;
 	int all_area_segs, sit_area_segs, nat_area_segs, ssa_area_segs;
 	int main_area_segs, main_area_sections, main_area_zones;
-	int hit_ext, total_ext;
+	int hit_ext, total_ext, tree_hit_ext, miss_ext, ext_node;
 	int ndirty_node, ndirty_dent, ndirty_dirs, ndirty_meta;
 	int nats, sits, fnids;
 	int total_count, utilization;
@@ -1308,6 +1370,11 @@ struct f2fs_stat_info {
 
 	unsigned int segment_count[2];
 	unsigned int block_count[2];
+	unsigned int data_type_blks[NR_CURSEG_DATA_TYPE];
+	unsigned int gc_type_blks[NR_CURSEG_DATA_TYPE];
+	unsigned int nr_discard_cmds, nr_pending_discards;
+	unsigned long long issued_discards, issued_discard_blks;
+	unsigned long long merged_discards, cancelled_discard_blks;
 	unsigned base_mem, cache_mem;
 };
 
@@ -1323,6 +1390,10 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 #define stat_dec_dirty_dir(sbi)		((sbi)->n_dirty_dirs--)
 #define stat_inc_total_hit(sb)		((F2FS_SB(sb))->total_hit_ext++)
 #define stat_inc_read_hit(sb)		((F2FS_SB(sb))->read_hit_ext++)
+#define stat_inc_tree_hit(sb)		((F2FS_SB(sb))->tree_hit_ext++)
+#define stat_inc_miss_ext(sb)		((F2FS_SB(sb))->miss_ext++)
+#define stat_inc_ext_node(sb)		(atomic_inc(&F2FS_SB(sb)->total_ext_node))
+#define stat_dec_ext_node(sb)		(atomic_dec(&F2FS_SB(sb)->total_ext_node))
 #define stat_inc_inline_inode(inode)					\
 	do {								\
 		if (f2fs_has_inline_data(inode))			\
@@ -1338,6 +1409,10 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 		((sbi)->segment_count[(curseg)->alloc_type]++)
 #define stat_inc_block_count(sbi, curseg)				\
 		((sbi)->block_count[(curseg)->alloc_type]++)
+#define stat_inc_data_type_count(sbi, type)				\
+		((sbi)->data_type_blks[type]++)
+#define stat_inc_gc_data_type_count(sbi, type)				\
+		((sbi)->gc_type_blks[type]++)
 
 #define stat_inc_seg_count(sbi, type)					\
 	do {								\
@@ -1378,10 +1453,16 @@ void f2fs_destroy_root_stats(void);
 #define stat_dec_dirty_dir(sbi)
 #define stat_inc_total_hit(sb)
 #define stat_inc_read_hit(sb)
+#define stat_inc_tree_hit(sb)
+#define stat_inc_miss_ext(sb)
+#define stat_inc_ext_node(sb)
+#define stat_dec_ext_node(sb)
 #define stat_inc_inline_inode(inode)
 #define stat_dec_inline_inode(inode)
 #define stat_inc_seg_type(sbi, curseg)
 #define stat_inc_block_count(sbi, curseg)
+#define stat_inc_data_type_count(sbi, type)
+#define stat_inc_gc_data_type_count(sbi, type)
 #define stat_inc_seg_count(si, type)
 #define stat_inc_tot_blk_count(si, blks)
 #define stat_inc_data_blk_count(si, blks)
@@ -245,6 +245,83 @@ static inline unsigned int get_gc_cost(struct f2fs_sb_info *sbi,
 		return get_cb_cost(sbi, segno);
 }
 
+/*
+ * The best cost-benefit that a section in a given bucket can have,
+ * i.e., the one of the oldest section with the least valid blocks.
+ */
+static unsigned int get_cb_bound(struct f2fs_sb_info *sbi, unsigned int bucket)
+{
+	unsigned int vblocks = bucket << DIRTY_I(sbi)->vindex.bucket_shift;
+	unsigned char u;
+
+	vblocks = vblocks / sbi->segs_per_sec;
+	u = (vblocks * 100) >> sbi->log_blocks_per_seg;
+
+	return UINT_MAX - ((100 * (100 - u) * 100) / (100 + u));
+}
+
+/*
+ * Select a victim section for cleaning from the victim index instead of
+ * scanning the dirty segmap.
+ * Buckets are visited in the order of valid blocks, and we can stop as soon
+ * as the lower bound of the next bucket cannot beat the current minimum cost.
+ * The order within a bucket says nothing reliable about age (after mount it is
+ * just segno order), so sections are costed one by one until the bucket's
+ * bound is reached or max_search sections have been looked at.
+ */
+static void get_victim_from_index(struct f2fs_sb_info *sbi, int gc_type,
+					struct victim_sel_policy *p)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	struct victim_index *vi = &dirty_i->vindex;
+	unsigned int bucket = 0;
+	int nsearched = 0;
+
+	while (1) {
+		struct victim_entry *ve;
+		unsigned int bound;
+
+		bucket = find_next_bit(vi->bucket_map, vi->nr_buckets, bucket);
+		if (bucket >= vi->nr_buckets)
+			break;
+
+		if (p->gc_mode == GC_GREEDY)
+			bound = bucket << vi->bucket_shift;
+		else
+			bound = get_cb_bound(sbi, bucket);
+		if (p->min_segno != NULL_SEGNO && bound >= p->min_cost)
+			break;
+
+		list_for_each_entry(ve, &vi->buckets[bucket], list) {
+			unsigned int secno = ve - vi->entries;
+			unsigned int segno = secno * sbi->segs_per_sec;
+			unsigned int cost;
+
+			if (sec_usage_check(sbi, secno))
+				continue;
+			if (gc_type == BG_GC &&
+					test_bit(secno, dirty_i->victim_secmap))
+				continue;
+
+			cost = get_gc_cost(sbi, segno, p);
+			if (p->min_cost > cost) {
+				p->min_segno = segno;
+				p->min_cost = cost;
+			}
+			nsearched++;
+
+			if (p->min_cost <= bound)
+				break;
+			if (nsearched >= p->max_search)
+				break;
+		}
+
+		if (nsearched >= p->max_search)
+			break;
+		bucket++;
+	}
+}
+
 /*
  * This function is called from two pathes.
  * One is garbage collection and the other is SSR segment selection.
@@ -275,6 +352,11 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			goto got_it;
 	}
 
+	if (p.alloc_mode == LFS) {
+		get_victim_from_index(sbi, gc_type, &p);
+		goto out;
+	}
+
 	while (1) {
 		unsigned long cost;
 		unsigned int segno;
@@ -315,6 +397,7 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			break;
 		}
 	}
+out:
 	if (p.min_segno != NULL_SEGNO) {
 got_it:
 		if (p.alloc_mode == LFS) {
@@ -392,11 +475,12 @@ static int check_valid_map(struct f2fs_sb_info *sbi,
  * On validity, copy that node with cold status, otherwise (invalid node)
  * ignore that.
  */
-static void gc_node_segment(struct f2fs_sb_info *sbi,
+static int gc_node_segment(struct f2fs_sb_info *sbi,
 		struct f2fs_summary *sum, unsigned int segno, int gc_type)
 {
 	bool initial = true;
 	struct f2fs_summary *entry;
+	int moved = 0;
 	int off;
 
 next_step:
@@ -408,7 +492,7 @@ next_step:
 
 		/* stop BG_GC if there is not enough free sections. */
 		if (gc_type == BG_GC && has_not_enough_free_secs(sbi, 0))
-			return;
+			return moved;
 
 		if (check_valid_map(sbi, segno, off) == 0)
 			continue;
@@ -431,6 +515,7 @@ next_step:
 		}
 		f2fs_put_page(node_page, 1);
 		stat_inc_node_blk_count(sbi, 1);
+		moved++;
 	}
 
 	if (initial) {
@@ -453,6 +538,7 @@ next_step:
 		if (get_valid_blocks(sbi, segno, 1) != 0)
 			goto next_step;
 	}
+	return moved;
 }
 
 /*
@@ -545,12 +631,14 @@ out:
  * If the parent node is not valid or the data block address is different,
  * the victim data block is ignored.
  */
-static void gc_data_segment(struct f2fs_sb_info *sbi, struct f2fs_summary *sum,
+static int gc_data_segment(struct f2fs_sb_info *sbi, struct f2fs_summary *sum,
 		struct list_head *ilist, unsigned int segno, int gc_type)
 {
 	struct super_block *sb = sbi->sb;
 	struct f2fs_summary *entry;
 	block_t start_addr;
+	unsigned char type = get_seg_entry(sbi, segno)->type;
+	int moved = 0;
 	int off;
 	int phase = 0;
 
@@ -568,7 +656,7 @@ next_step:
 
 		/* stop BG_GC if there is not enough free sections. */
 		if (gc_type == BG_GC && has_not_enough_free_secs(sbi, 0))
-			return;
+			return moved;
 
 		if (check_valid_map(sbi, segno, off) == 0)
 			continue;
@@ -614,6 +702,9 @@ next_step:
 					continue;
 				move_data_page(inode, data_page, gc_type);
 				stat_inc_data_blk_count(sbi, 1);
+				if (IS_DATASEG(type))
+					stat_inc_gc_data_type_count(sbi, type);
+				moved++;
 			}
 		}
 		continue;
@@ -636,6 +727,7 @@ next_iput:
 			goto next_step;
 		}
 	}
+	return moved;
 }
 
 static int __get_victim(struct f2fs_sb_info *sbi, unsigned int *victim,
@@ -649,12 +741,13 @@ static int __get_victim(struct f2fs_sb_info *sbi, unsigned int *victim,
 	return ret;
 }
 
-static void do_garbage_collect(struct f2fs_sb_info *sbi, unsigned int segno,
+static int do_garbage_collect(struct f2fs_sb_info *sbi, unsigned int segno,
 				struct list_head *ilist, int gc_type)
 {
 	struct page *sum_page;
 	struct f2fs_summary_block *sum;
 	struct blk_plug plug;
+	int moved = 0;
 
 	/* read segment summary of victim */
 	sum_page = get_sum_page(sbi, segno);
@@ -665,10 +758,11 @@ static void do_garbage_collect(struct f2fs_sb_info *sbi, unsigned int segno,
 
 	switch (GET_SUM_TYPE((&sum->footer))) {
 	case SUM_TYPE_NODE:
-		gc_node_segment(sbi, sum->entries, segno, gc_type);
+		moved = gc_node_segment(sbi, sum->entries, segno, gc_type);
 		break;
 	case SUM_TYPE_DATA:
-		gc_data_segment(sbi, sum->entries, ilist, segno, gc_type);
+		moved = gc_data_segment(sbi, sum->entries, ilist, segno,
+								gc_type);
 		break;
 	}
 	blk_finish_plug(&plug);
@@ -677,15 +771,19 @@ static void do_garbage_collect(struct f2fs_sb_info *sbi, unsigned int segno,
 	stat_inc_call_count(sbi->stat_info);
 
 	f2fs_put_page(sum_page, 1);
+	return moved;
 }
 
 int f2fs_gc(struct f2fs_sb_info *sbi)
 {
 	struct list_head ilist;
 	unsigned int segno, i;
+	unsigned int valid;
 	int gc_type = BG_GC;
 	int nfree = 0;
+	int moved;
 	int ret = -1;
+	ktime_t start;
 
 	INIT_LIST_HEAD(&ilist);
 gc_more:
@@ -708,8 +806,13 @@ gc_more:
 		ra_meta_pages(sbi, GET_SUM_BLOCK(sbi, segno), sbi->segs_per_sec,
 								META_SSA);
 
+	start = ktime_get();
+	valid = get_valid_blocks(sbi, segno, sbi->segs_per_sec);
+	moved = 0;
 	for (i = 0; i < sbi->segs_per_sec; i++)
-		do_garbage_collect(sbi, segno + i, &ilist, gc_type);
+		moved += do_garbage_collect(sbi, segno + i, &ilist, gc_type);
+	trace_f2fs_gc_section(sbi->sb, GET_SECNO(sbi, segno), gc_type,
+			valid, moved, ktime_us_delta(ktime_get(), start));
 
 	if (gc_type == FG_GC) {
 		sbi->cur_victim_sec = NULL_SEGNO;
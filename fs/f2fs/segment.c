@@ -14,17 +14,20 @@
 #include <linux/blkdev.h>
 #include <linux/prefetch.h>
 #include <linux/kthread.h>
+#include <linux/freezer.h>
 #include <linux/vmalloc.h>
 #include <linux/swap.h>
 
 #include "f2fs.h"
 #include "segment.h"
 #include "node.h"
+#include "gc.h"
 #include <trace/events/f2fs.h>
 
 #define __reverse_ffz(x) __reverse_ffs(~(x))
 
 static struct kmem_cache *discard_entry_slab;
+static struct kmem_cache *discard_cmd_slab;
 
 /*
  * __reverse_ffs is copied from include/asm-generic/bitops/__ffs.h since
@@ -296,6 +299,56 @@ void destroy_flush_cmd_control(struct f2fs_sb_info *sbi)
 	sbi->sm_info->cmd_control_info = NULL;
 }
 
+/*
+ * The victim index follows the DIRTY seglist, so it should be updated under
+ * seglist_lock as well.
+ */
+static void __update_victim_entry(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->vindex;
+	struct victim_entry *ve = &vi->entries[GET_SECNO(sbi, segno)];
+	unsigned int bucket = get_victim_bucket(sbi, segno);
+
+	if (ve->bucket == NULL_BUCKET) {
+		vi->nr_entries++;
+	} else {
+		list_del(&ve->list);
+		if (list_empty(&vi->buckets[ve->bucket]))
+			clear_bit(ve->bucket, vi->bucket_map);
+	}
+
+	/* the most recently indexed section goes to the tail */
+	list_add_tail(&ve->list, &vi->buckets[bucket]);
+	set_bit(bucket, vi->bucket_map);
+	ve->bucket = bucket;
+}
+
+static void __remove_victim_entry(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	struct victim_index *vi = &dirty_i->vindex;
+	unsigned int secno = GET_SECNO(sbi, segno);
+	unsigned int start = secno * sbi->segs_per_sec;
+	unsigned int end = start + sbi->segs_per_sec;
+	struct victim_entry *ve = &vi->entries[secno];
+
+	if (ve->bucket == NULL_BUCKET)
+		return;
+
+	/* keep the section indexed while it has other dirty segments */
+	if (sbi->segs_per_sec > 1 &&
+		find_next_bit(dirty_i->dirty_segmap[DIRTY], end, start) < end) {
+		__update_victim_entry(sbi, segno);
+		return;
+	}
+
+	list_del(&ve->list);
+	if (list_empty(&vi->buckets[ve->bucket]))
+		clear_bit(ve->bucket, vi->bucket_map);
+	ve->bucket = NULL_BUCKET;
+	vi->nr_entries--;
+}
+
 static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		enum dirty_type dirty_type)
 {
@@ -314,6 +367,8 @@ static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 
 		if (!test_and_set_bit(segno, dirty_i->dirty_segmap[t]))
 			dirty_i->nr_dirty[t]++;
+
+		__update_victim_entry(sbi, segno);
 	}
 }
 
@@ -332,6 +387,8 @@ static void __remove_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		if (test_and_clear_bit(segno, dirty_i->dirty_segmap[t]))
 			dirty_i->nr_dirty[t]--;
 
+		__remove_victim_entry(sbi, segno);
+
 		if (get_valid_blocks(sbi, segno, sbi->segs_per_sec) == 0)
 			clear_bit(GET_SECNO(sbi, segno),
 						dirty_i->victim_secmap);
@@ -377,6 +434,334 @@ static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
 	return blkdev_issue_discard(sbi->sb->s_bdev, start, len, GFP_NOFS, 0);
 }
 
+static void __mark_discard_segs(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	unsigned int start = GET_SEGNO(sbi, blkstart);
+	unsigned int end = GET_SEGNO(sbi, blkstart + blklen - 1);
+
+	for (; start <= end; start++)
+		set_bit(start, dcc->pend_segmap);
+}
+
+/*
+ * Queue a discard to the discard thread instead of issuing it right away.
+ * Pending cmds are kept in address order and never overlap: a new range is
+ * merged with every cmd it overlaps or touches.
+ * This is called during checkpoint, while block allocation is blocked.
+ */
+static void f2fs_queue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *prev = NULL, *dc;
+	block_t blkend = blkstart + blklen;
+	bool wakeup;
+
+	if (!dcc) {
+		f2fs_issue_discard(sbi, blkstart, blklen);
+		return;
+	}
+
+	mutex_lock(&dcc->cmd_lock);
+	if (!dcc->f2fs_issue_discard) {
+		/* the thread is stopped, see stop_discard_thread() */
+		mutex_unlock(&dcc->cmd_lock);
+		f2fs_issue_discard(sbi, blkstart, blklen);
+		return;
+	}
+
+	/* the thread only sleeps without a timeout while it has nothing */
+	wakeup = !dcc->nr_cmds;
+
+	/* new discards tend to be located at the end of the list */
+	list_for_each_entry_reverse(dc, &dcc->cmd_list, list) {
+		if (dc->blkaddr <= blkstart) {
+			prev = dc;
+			break;
+		}
+	}
+
+	__mark_discard_segs(sbi, blkstart, blklen);
+
+	if (prev && prev->blkaddr + prev->len >= blkstart) {
+		block_t len = max(prev->blkaddr + prev->len, blkend) -
+							prev->blkaddr;
+
+		dcc->nr_pending += len - prev->len;
+		prev->len = len;
+		dcc->merged_cmds++;
+		dc = prev;
+	} else {
+		dc = f2fs_kmem_cache_alloc(discard_cmd_slab, GFP_NOFS);
+		dc->blkaddr = blkstart;
+		dc->len = blklen;
+		list_add(&dc->list, prev ? &prev->list : &dcc->cmd_list);
+		dcc->nr_cmds++;
+		dcc->nr_pending += blklen;
+	}
+
+	/* swallow the following cmds that the range overlaps or touches */
+	while (!list_is_last(&dc->list, &dcc->cmd_list)) {
+		struct discard_cmd *next = list_entry(dc->list.next,
+						struct discard_cmd, list);
+		block_t len;
+
+		if (next->blkaddr > dc->blkaddr + dc->len)
+			break;
+
+		len = max(dc->blkaddr + dc->len, next->blkaddr + next->len) -
+							dc->blkaddr;
+		dcc->nr_pending -= dc->len + next->len - len;
+		dc->len = len;
+		list_del(&next->list);
+		kmem_cache_free(discard_cmd_slab, next);
+		dcc->nr_cmds--;
+		dcc->merged_cmds++;
+	}
+	mutex_unlock(&dcc->cmd_lock);
+
+	if (wakeup)
+		wake_up_interruptible(&dcc->discard_wait_queue);
+}
+
+static inline bool discard_overlaps(block_t blkaddr, block_t len,
+						block_t start, block_t end)
+{
+	return len && blkaddr < end && blkaddr + len > start;
+}
+
+/*
+ * A segment is about to be written, so drop its pending discards
+ * and wait for the in-flight one covering it, if any.
+ */
+static void __punch_discard_cmds(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	block_t start = START_BLOCK(sbi, segno);
+	block_t end = start + sbi->blocks_per_seg;
+	struct discard_cmd *dc, *tmp;
+
+	mutex_lock(&dcc->cmd_lock);
+	while (discard_overlaps(dcc->issue_blkaddr, dcc->issue_len,
+							start, end)) {
+		mutex_unlock(&dcc->cmd_lock);
+		wait_event(dcc->issue_wait_queue,
+			!discard_overlaps(dcc->issue_blkaddr, dcc->issue_len,
+							start, end));
+		mutex_lock(&dcc->cmd_lock);
+	}
+
+	list_for_each_entry_safe(dc, tmp, &dcc->cmd_list, list) {
+		block_t dc_end = dc->blkaddr + dc->len;
+
+		if (dc->blkaddr >= end)
+			break;
+		if (dc_end <= start)
+			continue;
+
+		if (dc->blkaddr < start && dc_end > end) {
+			/* split it into two */
+			struct discard_cmd *new;
+
+			new = f2fs_kmem_cache_alloc(discard_cmd_slab,
+								GFP_NOFS);
+			new->blkaddr = end;
+			new->len = dc_end - end;
+			list_add(&new->list, &dc->list);
+			dc->len = start - dc->blkaddr;
+			dcc->nr_cmds++;
+			dcc->nr_pending -= end - start;
+			dcc->cancelled_blks += end - start;
+			break;
+		} else if (dc->blkaddr < start) {
+			dc->len = start - dc->blkaddr;
+			dcc->nr_pending -= dc_end - start;
+			dcc->cancelled_blks += dc_end - start;
+		} else if (dc_end > end) {
+			dc->len = dc_end - end;
+			dc->blkaddr = end;
+			dcc->nr_pending -= end - start;
+			dcc->cancelled_blks += end - start;
+		} else {
+			list_del(&dc->list);
+			dcc->nr_cmds--;
+			dcc->nr_pending -= dc->len;
+			dcc->cancelled_blks += dc->len;
+			kmem_cache_free(discard_cmd_slab, dc);
+		}
+	}
+	clear_bit(segno, dcc->pend_segmap);
+	mutex_unlock(&dcc->cmd_lock);
+}
+
+static inline void f2fs_wait_discard(struct f2fs_sb_info *sbi,
+						unsigned int segno)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (dcc && test_bit(segno, dcc->pend_segmap))
+		__punch_discard_cmds(sbi, segno);
+}
+
+/*
+ * Issue up to nr pending cmds in address order.
+ * Unless forced, stop as soon as the device has other requests to serve.
+ */
+static void issue_discard_cmds(struct f2fs_sb_info *sbi, int nr, bool force)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc;
+
+	while (nr-- > 0) {
+		mutex_lock(&dcc->cmd_lock);
+		if (list_empty(&dcc->cmd_list)) {
+			mutex_unlock(&dcc->cmd_lock);
+			break;
+		}
+		dc = list_first_entry(&dcc->cmd_list, struct discard_cmd, list);
+		list_del(&dc->list);
+		dcc->nr_cmds--;
+		dcc->nr_pending -= dc->len;
+		dcc->issue_blkaddr = dc->blkaddr;
+		dcc->issue_len = dc->len;
+		mutex_unlock(&dcc->cmd_lock);
+
+		f2fs_issue_discard(sbi, dc->blkaddr, dc->len);
+
+		mutex_lock(&dcc->cmd_lock);
+		dcc->issue_len = 0;
+		dcc->issued_cmds++;
+		dcc->issued_blks += dc->len;
+		mutex_unlock(&dcc->cmd_lock);
+		wake_up_all(&dcc->issue_wait_queue);
+
+		kmem_cache_free(discard_cmd_slab, dc);
+
+		if (!force && !is_idle(sbi))
+			break;
+	}
+}
+
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	wait_queue_head_t *q = &dcc->discard_wait_queue;
+
+	set_freezable();
+	set_user_nice(current, 19);
+
+	do {
+		if (!dcc->nr_cmds)
+			wait_event_interruptible(*q,
+				kthread_should_stop() || dcc->nr_cmds);
+		else
+			wait_event_interruptible_timeout(*q,
+				kthread_should_stop(),
+				msecs_to_jiffies(DEF_DISCARD_SLEEP_TIME));
+		if (try_to_freeze())
+			continue;
+		if (kthread_should_stop())
+			break;
+
+		if (dcc->nr_pending > SM_I(sbi)->max_pending_discards)
+			issue_discard_cmds(sbi, DISCARD_ISSUE_BATCH, true);
+		else if (is_idle(sbi))
+			issue_discard_cmds(sbi, DISCARD_ISSUE_BATCH, false);
+	} while (!kthread_should_stop());
+	return 0;
+}
+
+int start_discard_thread(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct task_struct *task;
+
+	if (dcc->f2fs_issue_discard)
+		return 0;
+
+	task = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(task))
+		return PTR_ERR(task);
+
+	mutex_lock(&dcc->cmd_lock);
+	dcc->f2fs_issue_discard = task;
+	mutex_unlock(&dcc->cmd_lock);
+	return 0;
+}
+
+/*
+ * Stop the thread and issue whatever is pending.  The control structure
+ * stays around until put_super, since allocation paths look it up without
+ * locking; discards queued from now on are issued right away.
+ */
+void stop_discard_thread(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct task_struct *task;
+
+	if (!dcc || !dcc->f2fs_issue_discard)
+		return;
+
+	mutex_lock(&dcc->cmd_lock);
+	task = dcc->f2fs_issue_discard;
+	dcc->f2fs_issue_discard = NULL;
+	mutex_unlock(&dcc->cmd_lock);
+
+	kthread_stop(task);
+
+	/* do not lose any discards */
+	issue_discard_cmds(sbi, INT_MAX, true);
+}
+
+int create_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (dcc)
+		return start_discard_thread(sbi);
+
+	dcc = kzalloc(sizeof(struct discard_cmd_control), GFP_KERNEL);
+	if (!dcc)
+		return -ENOMEM;
+
+	dcc->pend_segmap = kzalloc(f2fs_bitmap_size(TOTAL_SEGS(sbi)),
+								GFP_KERNEL);
+	if (!dcc->pend_segmap) {
+		kfree(dcc);
+		return -ENOMEM;
+	}
+
+	mutex_init(&dcc->cmd_lock);
+	INIT_LIST_HEAD(&dcc->cmd_list);
+	init_waitqueue_head(&dcc->discard_wait_queue);
+	init_waitqueue_head(&dcc->issue_wait_queue);
+
+	/* allocation paths may look at it as soon as it is published */
+	smp_wmb();
+	SM_I(sbi)->dcc_info = dcc;
+
+	return start_discard_thread(sbi);
+}
+
+void destroy_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc)
+		return;
+
+	stop_discard_thread(sbi);
+
+	SM_I(sbi)->dcc_info = NULL;
+	kfree(dcc->pend_segmap);
+	kfree(dcc);
+}
+
 void discard_next_dnode(struct f2fs_sb_info *sbi)
 {
 	struct curseg_info *curseg = CURSEG_I(sbi, CURSEG_WARM_NODE);
@@ -477,14 +862,14 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi)
 		if (!test_opt(sbi, DISCARD))
 			continue;
 
-		f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
+		f2fs_queue_discard(sbi, START_BLOCK(sbi, start),
 				(end - start) << sbi->log_blocks_per_seg);
 	}
 	mutex_unlock(&dirty_i->seglist_lock);
 
 	/* send small discards */
 	list_for_each_entry_safe(entry, this, head, list) {
-		f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		f2fs_queue_discard(sbi, entry->blkaddr, entry->len);
 		list_del(&entry->list);
 		SM_I(sbi)->nr_discards -= entry->len;
 		kmem_cache_free(discard_entry_slab, entry);
@@ -922,7 +1307,7 @@ static int __get_segment_type_4(struct page *page, enum page_type p_type)
 	if (p_type == DATA) {
 		struct inode *inode = page->mapping->host;
 
-		if (S_ISDIR(inode->i_mode))
+		if (S_ISDIR(inode->i_mode) || file_is_hot(inode))
 			return CURSEG_HOT_DATA;
 		else
 			return CURSEG_COLD_DATA;
@@ -943,6 +1328,8 @@ static int __get_segment_type_6(struct page *page, enum page_type p_type)
 			return CURSEG_HOT_DATA;
 		else if (is_cold_data(page) || file_is_cold(inode))
 			return CURSEG_COLD_DATA;
+		else if (file_is_hot(inode))
+			return CURSEG_HOT_DATA;
 		else
 			return CURSEG_WARM_DATA;
 	} else {
@@ -983,6 +1370,9 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 	*new_blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
 	old_cursegno = curseg->segno;
 
+	/* this segment must not be discarded after being written */
+	f2fs_wait_discard(sbi, curseg->segno);
+
 	/*
 	 * __add_sum_entry should be resided under the curseg_mutex
 	 * because, this function updates a summary entry in the
@@ -994,6 +1384,8 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 	__refresh_next_blkoff(sbi, curseg);
 
 	stat_inc_block_count(sbi, curseg);
+	if (page && IS_DATASEG(type) && !is_cold_data(page))
+		stat_inc_data_type_count(sbi, type);
 
 	if (!__has_curseg_space(sbi, type))
 		sit_i->s_ops->allocate_segment(sbi, type, false);
@@ -1820,6 +2212,37 @@ static int init_victim_secmap(struct f2fs_sb_info *sbi)
 	return 0;
 }
 
+static int init_victim_index(struct f2fs_sb_info *sbi)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->vindex;
+	unsigned int blocks_per_sec = sbi->blocks_per_seg * sbi->segs_per_sec;
+	unsigned int i;
+
+	vi->bucket_shift = 0;
+	while ((blocks_per_sec >> vi->bucket_shift) + 1 > MAX_VICTIM_BUCKETS)
+		vi->bucket_shift++;
+	vi->nr_buckets = (blocks_per_sec >> vi->bucket_shift) + 1;
+	vi->nr_entries = 0;
+
+	vi->buckets = kmalloc(vi->nr_buckets * sizeof(struct list_head),
+								GFP_KERNEL);
+	if (!vi->buckets)
+		return -ENOMEM;
+	for (i = 0; i < vi->nr_buckets; i++)
+		INIT_LIST_HEAD(&vi->buckets[i]);
+
+	vi->bucket_map = kzalloc(f2fs_bitmap_size(vi->nr_buckets), GFP_KERNEL);
+	if (!vi->bucket_map)
+		return -ENOMEM;
+
+	vi->entries = vzalloc(TOTAL_SECS(sbi) * sizeof(struct victim_entry));
+	if (!vi->entries)
+		return -ENOMEM;
+	for (i = 0; i < TOTAL_SECS(sbi); i++)
+		vi->entries[i].bucket = NULL_BUCKET;
+	return 0;
+}
+
 static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i;
@@ -1841,6 +2264,9 @@ static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 			return -ENOMEM;
 	}
 
+	if (init_victim_index(sbi))
+		return -ENOMEM;
+
 	init_dirty_segmap(sbi);
 	return init_victim_secmap(sbi);
 }
@@ -1903,6 +2329,8 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 	INIT_LIST_HEAD(&sm_info->discard_list);
 	sm_info->nr_discards = 0;
 	sm_info->max_discards = 0;
+	sm_info->max_pending_discards = DEF_MAX_PENDING_DISCARDS;
+	sm_info->hot_data_thresh = DEF_HOT_DATA_THRESH;
 	
 	if (test_opt(sbi, FLUSH_MERGE) && !f2fs_readonly(sbi->sb)) {
 		err = create_flush_cmd_control(sbi);
@@ -1929,6 +2357,9 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 		return err;
 
 	init_min_max_mtime(sbi);
+
+	if (test_opt(sbi, DISCARD) && !f2fs_readonly(sbi->sb))
+		return create_discard_cmd_control(sbi);
 	return 0;
 }
 
@@ -1949,6 +2380,15 @@ static void destroy_victim_secmap(struct f2fs_sb_info *sbi)
 	kfree(dirty_i->victim_secmap);
 }
 
+static void destroy_victim_index(struct f2fs_sb_info *sbi)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->vindex;
+
+	vfree(vi->entries);
+	kfree(vi->bucket_map);
+	kfree(vi->buckets);
+}
+
 static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
@@ -1962,6 +2402,7 @@ static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
 		discard_dirty_segmap(sbi, i);
 
 	destroy_victim_secmap(sbi);
+	destroy_victim_index(sbi);
 	SM_I(sbi)->dirty_info = NULL;
 	kfree(dirty_i);
 }
@@ -2020,6 +2461,7 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	if (!sm_info)
 		return;
 	destroy_flush_cmd_control(sbi);
+	destroy_discard_cmd_control(sbi);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
@@ -2034,10 +2476,18 @@ int __init create_segment_manager_caches(void)
 			sizeof(struct discard_entry));
 	if (!discard_entry_slab)
 		return -ENOMEM;
+
+	discard_cmd_slab = f2fs_kmem_cache_create("discard_cmd",
+			sizeof(struct discard_cmd));
+	if (!discard_cmd_slab) {
+		kmem_cache_destroy(discard_entry_slab);
+		return -ENOMEM;
+	}
 	return 0;
 }
 
 void destroy_segment_manager_caches(void)
 {
+	kmem_cache_destroy(discard_cmd_slab);
 	kmem_cache_destroy(discard_entry_slab);
 }
@@ -16,6 +16,15 @@
 
 #define DEF_RECLAIM_PREFREE_SEGMENTS	5	/* 5% over total segments */
 
+/* for the background discard thread */
+#define DEF_MAX_PENDING_DISCARDS	8192	/* blocks, issue even if busy */
+#define DEF_DISCARD_SLEEP_TIME		100	/* milliseconds */
+#define DISCARD_ISSUE_BATCH		8	/* # of cmds per wake-up */
+
+/* for the classification of hot data */
+#define DEF_HOT_DATA_THRESH		16	/* rewritten blocks */
+#define HOTNESS_DECAY_PERIOD		(30 * HZ)
+
 /* L: Logical segment # in volume, R: Relative segment # in main area */
 #define GET_L2R_SEGNO(free_i, segno)	(segno - free_i->start_segno)
 #define GET_R2L_SEGNO(free_i, segno)	(segno + free_i->start_segno)
@@ -212,12 +221,35 @@ enum dirty_type {
 	NR_DIRTY_TYPE
 };
 
+/*
+ * Dirty sections are indexed by their # of valid blocks, so that the cleaner
+ * can pick a victim without scanning the dirty segmap. Sections in a bucket
+ * are kept in the order they were last (re)indexed.
+ */
+#define MAX_VICTIM_BUCKETS	512
+#define NULL_BUCKET		((unsigned int)(~0))
+
+struct victim_entry {
+	struct list_head list;		/* linked in a bucket */
+	unsigned int bucket;		/* bucket # or NULL_BUCKET */
+};
+
+struct victim_index {
+	struct victim_entry *entries;	/* per-section entries */
+	struct list_head *buckets;	/* sections by # of valid blocks */
+	unsigned long *bucket_map;	/* bitmap of non-empty buckets */
+	unsigned int nr_buckets;	/* # of buckets */
+	unsigned int bucket_shift;	/* valid blocks >> shift = bucket # */
+	unsigned int nr_entries;	/* # of indexed sections */
+};
+
 struct dirty_seglist_info {
 	const struct victim_selection *v_ops;	/* victim selction operation */
 	unsigned long *dirty_segmap[NR_DIRTY_TYPE];
 	struct mutex seglist_lock;		/* lock for segment bitmaps */
 	int nr_dirty[NR_DIRTY_TYPE];		/* # of dirty segments */
 	unsigned long *victim_secmap;		/* background GC victims */
+	struct victim_index vindex;		/* dirty sections for cleaning */
 };
 
 /* victim selection function for cleaning and SSR */
@@ -272,6 +304,13 @@ static inline unsigned int get_valid_blocks(struct f2fs_sb_info *sbi,
 		return get_seg_entry(sbi, segno)->valid_blocks;
 }
 
+static inline unsigned int get_victim_bucket(struct f2fs_sb_info *sbi,
+				unsigned int segno)
+{
+	return get_valid_blocks(sbi, segno, sbi->segs_per_sec) >>
+					DIRTY_I(sbi)->vindex.bucket_shift;
+}
+
 static inline void seg_info_from_raw_sit(struct seg_entry *se,
 					struct f2fs_sit_entry *rs)
 {
@@ -478,6 +517,41 @@ enum {
 	F2FS_IPU_DISABLE,
 };
 
+/*
+ * The hotness of a file is the # of its data blocks rewritten recently,
+ * and it is halved every HOTNESS_DECAY_PERIOD.
+ * It is updated without any lock, since it is just a hint.
+ */
+static inline unsigned int file_hotness(struct inode *inode,
+					unsigned long *periods)
+{
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+
+	*periods = (jiffies - fi->i_hotness_stamp) / HOTNESS_DECAY_PERIOD;
+	if (*periods >= sizeof(fi->i_hotness) * BITS_PER_BYTE)
+		return 0;
+	return fi->i_hotness >> *periods;
+}
+
+static inline void file_inc_hotness(struct inode *inode)
+{
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	unsigned long periods;
+	unsigned int hotness = file_hotness(inode, &periods);
+
+	fi->i_hotness_stamp += periods * HOTNESS_DECAY_PERIOD;
+	fi->i_hotness = hotness + 1;
+}
+
+static inline bool file_is_hot(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	unsigned int thresh = SM_I(sbi)->hot_data_thresh;
+	unsigned long periods;
+
+	return thresh && file_hotness(inode, &periods) >= thresh;
+}
+
 static inline bool need_inplace_update(struct inode *inode)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
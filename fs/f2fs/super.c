@@ -186,6 +186,9 @@ F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_no_gc_sleep_time, no_gc_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_idle, gc_idle);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, reclaim_segments, rec_prefree_segments);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, max_small_discards, max_discards);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, max_pending_discards,
+						max_pending_discards);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, hot_data_thresh, hot_data_thresh);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, ipu_policy, ipu_policy);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, min_ipu_util, min_ipu_util);
 F2FS_RW_ATTR(NM_INFO, f2fs_nm_info, ram_thresh, ram_thresh);
@@ -200,6 +203,8 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(gc_idle),
 	ATTR_LIST(reclaim_segments),
 	ATTR_LIST(max_small_discards),
+	ATTR_LIST(max_pending_discards),
+	ATTR_LIST(hot_data_thresh),
 	ATTR_LIST(ipu_policy),
 	ATTR_LIST(min_ipu_util),
 	ATTR_LIST(max_victim_search),
@@ -364,7 +369,10 @@ static struct inode *f2fs_alloc_inode(struct super_block *sb)
 	atomic_set(&fi->dirty_dents, 0);
 	fi->i_current_depth = 1;
 	fi->i_advise = 0;
+	fi->i_hotness_stamp = jiffies;
 	rwlock_init(&fi->ext.ext_lock);
+	rwlock_init(&fi->ext_tree.lock);
+	fi->ext_tree.root = RB_ROOT;
 	init_rwsem(&fi->i_sem);
 
 	set_inode_flag(fi, FI_NEW_INODE);
@@ -578,8 +586,11 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 	struct f2fs_sb_info *sbi = F2FS_SB(sb);
 	struct f2fs_mount_info org_mount_opt;
 	int err, active_logs;
+	struct discard_cmd_control *dcc;
 	bool need_restart_gc = false;
 	bool need_stop_gc = false;
+	bool need_restart_discard = false;
+	bool need_stop_discard = false;
 
 	/*
 	 * Save the old mount options in case we
@@ -618,6 +629,24 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 		need_stop_gc = true;
 	}
 
+	/*
+	 * Likewise, pending discards are issued and the discard thread is
+	 * stopped if FS is mounted as RO or discard is not passed anymore.
+	 * The discard control itself lives until put_super.
+	 */
+	dcc = sbi->sm_info->dcc_info;
+	if ((*flags & MS_RDONLY) || !test_opt(sbi, DISCARD)) {
+		if (dcc && dcc->f2fs_issue_discard) {
+			stop_discard_thread(sbi);
+			need_restart_discard = true;
+		}
+	} else if (!dcc || !dcc->f2fs_issue_discard) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			goto restore_gc;
+		need_stop_discard = true;
+	}
+
 	/*
 	 * We stop issue flush thread if FS is mounted as RO
 	 * or if flush_merge is not passed in mount option.
@@ -628,7 +657,7 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 					!sbi->sm_info->cmd_control_info) {
 		err = create_flush_cmd_control(sbi);
 		if (err)
-			goto restore_gc;
+			goto restore_discard;
 	}
 skip:
 	/* Update the POSIXACL Flag */
@@ -636,6 +665,14 @@ skip:
 		(test_opt(sbi, POSIX_ACL) ? MS_POSIXACL : 0);
 	return 0;
 
+restore_discard:
+	if (need_restart_discard) {
+		if (start_discard_thread(sbi))
+			f2fs_msg(sbi->sb, KERN_WARNING,
+				"discard thread is stop");
+	} else if (need_stop_discard) {
+		stop_discard_thread(sbi);
+	}
 restore_gc:
 	if (need_restart_gc) {
 		if (start_gc_thread(sbi))
@@ -1153,10 +1190,13 @@ static int __init init_f2fs_fs(void)
 	err = create_checkpoint_caches();
 	if (err)
 		goto free_gc_caches;
+	err = create_extent_cache();
+	if (err)
+		goto free_checkpoint_caches;
 	f2fs_kset = kset_create_and_add("f2fs", NULL, fs_kobj);
 	if (!f2fs_kset) {
 		err = -ENOMEM;
-		goto free_checkpoint_caches;
+		goto free_extent_cache;
 	}
 	err = register_filesystem(&f2fs_fs_type);
 	if (err)
@@ -1167,6 +1207,8 @@ static int __init init_f2fs_fs(void)
 
 free_kset:
 	kset_unregister(f2fs_kset);
+free_extent_cache:
+	destroy_extent_cache();
 free_checkpoint_caches:
 	destroy_checkpoint_caches();
 free_gc_caches:
@@ -1186,6 +1228,7 @@ static void __exit exit_f2fs_fs(void)
 	remove_proc_entry("fs/f2fs", NULL);
 	f2fs_destroy_root_stats();
 	unregister_filesystem(&f2fs_fs_type);
+	destroy_extent_cache();
 	destroy_checkpoint_caches();
 	destroy_gc_caches();
 	destroy_segment_manager_caches();
@@ -32,10 +32,21 @@ extern uint32_t acpu_check_khz_value(unsigned long khz);
 
 #define CPUFREQ_TRANSITION_NOTIFIER	(0)
 #define CPUFREQ_POLICY_NOTIFIER		(1)
+#define CPUFREQ_BOOST_NOTIFIER		(2)
+
+/*
+ * Passed to CPUFREQ_BOOST_NOTIFIER callbacks.  Zero fields ask for the
+ * governor's own boost frequency or duration.
+ */
+struct cpufreq_boost {
+	unsigned int freq;		/* kHz */
+	unsigned int duration_us;
+};
 
 #ifdef CONFIG_CPU_FREQ
 int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list);
 int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list);
+void cpufreq_boost(unsigned int freq, unsigned int duration_us);
 #else		/* CONFIG_CPU_FREQ */
 static inline int cpufreq_register_notifier(struct notifier_block *nb,
 						unsigned int list)
@@ -47,6 +58,9 @@ static inline int cpufreq_unregister_notifier(struct notifier_block *nb,
 {
 	return 0;
 }
+static inline void cpufreq_boost(unsigned int freq, unsigned int duration_us)
+{
+}
 #endif		/* CONFIG_CPU_FREQ */
 
 /* if (cpufreq_driver->target) exists, the ->governor decides what frequency
@@ -672,6 +672,18 @@ static inline bool device_async_suspend_enabled(struct device *dev)
 	return !!dev->power.async_suspend;
 }
 
+/*
+ * Like device_enable_async_suspend(), and devices registered below @dev
+ * later on are made asynchronous as well.
+ */
+static inline void device_enable_async_subtree(struct device *dev)
+{
+	if (!dev->power.is_prepared) {
+		dev->power.async_suspend = true;
+		dev->power.async_subtree = true;
+	}
+}
+
 static inline void device_lock(struct device *dev)
 {
 	mutex_lock(&dev->mutex);
@@ -18,6 +18,7 @@
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/list.h>
+#include <linux/types.h>
 #endif
 
 /* The early_suspend structure defines suspend and resume hooks to be called
@@ -29,6 +30,9 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ * Handlers registered at the same level may be called concurrently (see the
+ * earlysuspend "concurrent" module parameter), so a handler must not depend
+ * on another handler of its own level having run first.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
@@ -41,6 +45,17 @@ struct early_suspend {
 	int level;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
+	/* filled in by kernel/power/earlysuspend.c, in microseconds */
+	struct {
+		u32 suspend_count;
+		u32 suspend_last;
+		u32 suspend_max;
+		u64 suspend_total;
+		u32 resume_count;
+		u32 resume_last;
+		u32 resume_max;
+		u64 resume_total;
+	} stats;
 #endif
 };
 
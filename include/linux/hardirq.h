@@ -145,8 +145,7 @@ extern int rcu_nmi_seen;
 # define rcu_irq_exit() do { } while (0)
 # define rcu_nmi_enter() do { rcu_nmi_seen = 1; } while (0)
 # define rcu_nmi_exit() do { } while (0)
-#endif
-#if defined(CONFIG_TINY_RCU) || defined(CONFIG_TINY_PREEMPT_RCU)
+#elif defined(CONFIG_TINY_RCU) || defined(CONFIG_TINY_PREEMPT_RCU)
 
 static inline void rcu_nmi_enter(void)
 {
@@ -32,6 +32,7 @@ extern void call_rcu_sched(struct rcu_head *head, void (*func)(struct rcu_head *
 
 #define call_rcu_bh                            call_rcu_sched
 #define call_rcu                               call_rcu_sched
+#define kfree_call_rcu                         call_rcu_sched
 
 extern void rcu_barrier(void);
 
@@ -50,10 +51,9 @@ extern void synchronize_sched(void);
 #define rcu_init_sched()                       do { } while (0)
 #define exit_rcu()                             do { } while (0)
 
-static inline void __rcu_check_callbacks(int cpu, int user) { }
-#define rcu_check_callbacks                    __rcu_check_callbacks
+extern void rcu_check_callbacks(int cpu, int user);
+extern int rcu_needs_cpu(int cpu);
 
-#define rcu_needs_cpu(cpu)                     (0)
 #define rcu_batches_completed()                        (0)
 #define rcu_batches_completed_bh()             (0)
 #define rcu_preempt_depth()                    (0)
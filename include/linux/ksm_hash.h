@@ -0,0 +1,68 @@
+#ifndef _LINUX_KSM_HASH_H
+#define _LINUX_KSM_HASH_H
+
+/*
+ * Page change-detection hash used by ksmd.
+ *
+ * The main loop keeps four independent 32-bit accumulators (the xxhash32
+ * round), so it has no carried dependency between adjacent words and
+ * scalar cores can overlap the multiplies.
+ * The hash only has to notice that a page changed between two ksmd passes;
+ * it never decides whether two pages are merged.
+ *
+ * An architecture with a faster version selects HAVE_ARCH_KSM_HASH and
+ * provides ksm_hash_words() in <asm/ksm_hash.h>.
+ */
+
+#include <linux/types.h>
+#include <linux/bitops.h>
+
+#ifdef CONFIG_HAVE_ARCH_KSM_HASH
+#include <asm/ksm_hash.h>
+#else
+
+#define KSM_HASH_LANES	4
+
+#define KSM_HASH_PRIME1	2654435761U
+#define KSM_HASH_PRIME2	2246822519U
+#define KSM_HASH_PRIME3	3266489917U
+#define KSM_HASH_PRIME4	668265263U
+
+static inline u32 ksm_hash_words(const u32 *p, unsigned int nwords, u32 seed)
+{
+	u32 v[KSM_HASH_LANES];
+	unsigned int i, j;
+	u32 h;
+
+	v[0] = seed + KSM_HASH_PRIME1 + KSM_HASH_PRIME2;
+	v[1] = seed + KSM_HASH_PRIME2;
+	v[2] = seed;
+	v[3] = seed - KSM_HASH_PRIME1;
+
+	for (i = 0; i + KSM_HASH_LANES <= nwords; i += KSM_HASH_LANES) {
+		for (j = 0; j < KSM_HASH_LANES; j++) {
+			v[j] += p[i + j] * KSM_HASH_PRIME2;
+			v[j] = (v[j] << 13) | (v[j] >> 19);
+			v[j] *= KSM_HASH_PRIME1;
+		}
+	}
+
+	h = rol32(v[0], 1) + rol32(v[1], 7) + rol32(v[2], 12) +
+		rol32(v[3], 18) + nwords * 4;
+
+	for (; i < nwords; i++) {
+		h += p[i] * KSM_HASH_PRIME3;
+		h = rol32(h, 17) * KSM_HASH_PRIME4;
+	}
+
+	h ^= h >> 15;
+	h *= KSM_HASH_PRIME2;
+	h ^= h >> 13;
+	h *= KSM_HASH_PRIME3;
+	h ^= h >> 16;
+
+	return h;
+}
+#endif /* CONFIG_HAVE_ARCH_KSM_HASH */
+
+#endif /* _LINUX_KSM_HASH_H */
@@ -0,0 +1,16 @@
+#ifndef _LINUX_LAUNCH_PREFETCH_H
+#define _LINUX_LAUNCH_PREFETCH_H
+
+#include <linux/types.h>
+
+struct file;
+
+#ifdef CONFIG_LAUNCH_PREFETCH
+extern void launch_prefetch_fault(struct file *file, pgoff_t index);
+#else
+static inline void launch_prefetch_fault(struct file *file, pgoff_t index)
+{
+}
+#endif
+
+#endif /* _LINUX_LAUNCH_PREFETCH_H */
@@ -425,6 +425,7 @@ struct dev_pm_info {
 	pm_message_t		power_state;
 	unsigned int		can_wakeup:1;
 	unsigned int		async_suspend:1;
+	unsigned int		async_subtree:1;
 	bool			is_prepared:1;	/* Owned by the PM core */
 	bool			is_suspended:1;	/* Ditto */
 	spinlock_t		lock;
@@ -432,6 +433,8 @@ struct dev_pm_info {
 	struct list_head	entry;
 	struct completion	completion;
 	struct wakeup_source	*wakeup;
+	struct list_head	suppliers;	/* Owned by the PM core */
+	struct list_head	consumers;	/* Ditto */
 #else
 	unsigned int		should_wakeup:1;
 #endif
@@ -551,6 +554,10 @@ extern void __suspend_report_result(const char *function, void *fn, int ret);
 	} while (0)
 
 extern int device_pm_wait_for_dev(struct device *sub, struct device *dev);
+extern int device_pm_add_dependency(struct device *consumer,
+				    struct device *supplier);
+extern void device_pm_remove_dependency(struct device *consumer,
+					struct device *supplier);
 
 extern int pm_generic_prepare(struct device *dev);
 extern int pm_generic_suspend(struct device *dev);
@@ -578,6 +585,15 @@ static inline int device_pm_wait_for_dev(struct device *a, struct device *b)
 	return 0;
 }
 
+static inline int device_pm_add_dependency(struct device *consumer,
+					   struct device *supplier)
+{
+	return 0;
+}
+
+static inline void device_pm_remove_dependency(struct device *consumer,
+					       struct device *supplier) {}
+
 #define pm_generic_prepare	NULL
 #define pm_generic_suspend	NULL
 #define pm_generic_resume	NULL
@@ -1181,6 +1181,8 @@ struct sched_statistics {
 	u64			nr_wakeups_affine_attempts;
 	u64			nr_wakeups_passive;
 	u64			nr_wakeups_idle;
+
+	u64			wakeup_start;
 };
 #endif
 
@@ -1265,6 +1267,13 @@ struct task_struct {
 #ifdef CONFIG_CGROUP_SCHED
 	struct task_group *sched_task_group;
 #endif
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	/* recent demand, see task_demand_update() in kernel/sched.c */
+	u64 demand_window_start;
+	u64 demand_mark;
+	u64 demand_busy;
+	unsigned int demand;
+#endif
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	/* list of struct preempt_notifier: */
@@ -2065,6 +2074,44 @@ static inline void sched_autogroup_exit(struct signal_struct *sig) { }
 extern unsigned int sysctl_sched_cfs_bandwidth_slice;
 #endif
 
+/* Passed to the sched migration notifiers. */
+struct sched_migration_note {
+	int src_cpu;
+	int dest_cpu;
+	unsigned int demand;	/* % of a window, at src_cpu's speed */
+};
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+extern unsigned int sysctl_sched_freq_window_us;
+extern unsigned int sysctl_sched_freq_alert_pct;
+extern unsigned int sysctl_sched_freq_migrate_pct;
+
+extern unsigned int sched_get_cpu_load(int cpu);
+extern int register_sched_load_notifier(struct notifier_block *nb);
+extern int unregister_sched_load_notifier(struct notifier_block *nb);
+extern int register_sched_migration_notifier(struct notifier_block *nb);
+extern int unregister_sched_migration_notifier(struct notifier_block *nb);
+#else
+static inline unsigned int sched_get_cpu_load(int cpu) { return 0; }
+static inline int register_sched_load_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int unregister_sched_load_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int register_sched_migration_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int unregister_sched_migration_notifier(
+	struct notifier_block *nb)
+{
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_RT_MUTEXES
 extern int rt_mutex_getprio(struct task_struct *p);
 extern void rt_mutex_setprio(struct task_struct *p, int prio);
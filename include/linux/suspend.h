@@ -6,6 +6,7 @@
 #include <linux/init.h>
 #include <linux/pm.h>
 #include <linux/mm.h>
+#include <linux/ktime.h>
 #include <asm/errno.h>
 
 #if defined(CONFIG_PM_SLEEP) && defined(CONFIG_VT) && defined(CONFIG_VT_CONSOLE)
@@ -326,4 +327,19 @@ static inline void unlock_system_sleep(void)
 }
 #endif
 
+struct device;
+
+#ifdef CONFIG_SUSPEND_TIME
+/* Per-device suspend/resume timing, kept by kernel/power/suspend_time.c */
+extern void suspend_time_dev_begin(bool resume);
+extern void suspend_time_dev_record(struct device *dev, bool resume,
+				    bool async, ktime_t starttime);
+extern void suspend_time_dev_end(bool resume, ktime_t starttime);
+#else
+static inline void suspend_time_dev_begin(bool resume) {}
+static inline void suspend_time_dev_record(struct device *dev, bool resume,
+					   bool async, ktime_t starttime) {}
+static inline void suspend_time_dev_end(bool resume, ktime_t starttime) {}
+#endif
+
 #endif /* _LINUX_SUSPEND_H */
@@ -17,6 +17,7 @@
 #define _LINUX_WAKELOCK_H
 
 #include <linux/list.h>
+#include <linux/rbtree.h>
 #include <linux/ktime.h>
 
 /* A wake_lock prevents the system from entering suspend or other low power
@@ -34,6 +35,7 @@ enum {
 
 struct wake_lock {
 	struct list_head    link;
+	struct rb_node      expire_node; /* only while active with a timeout */
 	int                 flags;
 	const char         *name;
 	unsigned long       expires;
@@ -514,6 +514,7 @@ TRACE_EVENT(f2fs_get_victim,
 		__field(int,	alloc_mode)
 		__field(int,	gc_mode)
 		__field(unsigned int,	victim)
+		__field(unsigned int,	cost)
 		__field(unsigned int,	ofs_unit)
 		__field(unsigned int,	pre_victim)
 		__field(unsigned int,	prefree)
@@ -527,6 +528,7 @@ TRACE_EVENT(f2fs_get_victim,
 		__entry->alloc_mode	= p->alloc_mode;
 		__entry->gc_mode	= p->gc_mode;
 		__entry->victim		= p->min_segno;
+		__entry->cost		= p->min_cost;
 		__entry->ofs_unit	= p->ofs_unit;
 		__entry->pre_victim	= pre_victim;
 		__entry->prefree	= prefree;
@@ -534,19 +536,56 @@ TRACE_EVENT(f2fs_get_victim,
 	),
 
 	TP_printk("dev = (%d,%d), type = %s, policy = (%s, %s, %s), victim = %u "
-		"ofs_unit = %u, pre_victim_secno = %d, prefree = %u, free = %u",
+		"cost = %u, ofs_unit = %u, pre_victim_secno = %d, prefree = %u, "
+		"free = %u",
 		show_dev(__entry),
 		show_data_type(__entry->type),
 		show_gc_type(__entry->gc_type),
 		show_alloc_mode(__entry->alloc_mode),
 		show_victim_policy(__entry->gc_mode),
 		__entry->victim,
+		__entry->cost,
 		__entry->ofs_unit,
 		(int)__entry->pre_victim,
 		__entry->prefree,
 		__entry->free)
 );
 
+TRACE_EVENT(f2fs_gc_section,
+
+	TP_PROTO(struct super_block *sb, unsigned int secno, int gc_type,
+			unsigned int valid, int moved, s64 elapsed),
+
+	TP_ARGS(sb, secno, gc_type, valid, moved, elapsed),
+
+	TP_STRUCT__entry(
+		__field(dev_t,	dev)
+		__field(unsigned int,	secno)
+		__field(int,	gc_type)
+		__field(unsigned int,	valid)
+		__field(int,	moved)
+		__field(s64,	elapsed)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= sb->s_dev;
+		__entry->secno		= secno;
+		__entry->gc_type	= gc_type;
+		__entry->valid		= valid;
+		__entry->moved		= moved;
+		__entry->elapsed	= elapsed;
+	),
+
+	TP_printk("dev = (%d,%d), secno = %u, %s, valid blocks = %u, "
+		"moved blocks = %d, elapsed = %lld us",
+		show_dev(__entry),
+		__entry->secno,
+		show_gc_type(__entry->gc_type),
+		__entry->valid,
+		__entry->moved,
+		__entry->elapsed)
+);
+
 TRACE_EVENT(f2fs_fallocate,
 
 	TP_PROTO(struct inode *inode, int mode,
@@ -115,6 +115,37 @@ DEFINE_EVENT(workqueue_work, workqueue_execute_end,
 	TP_ARGS(work)
 );
 
+/**
+ * workqueue_slow_work - called when a work ran for longer than a threshold
+ * @func:	the work function
+ * @runtime_ns:	how long the work function ran
+ * @latency_ns:	how long the work waited between being queued and starting
+ *
+ * This event occurs after a work function returns if it ran for at
+ * least the threshold set in debugfs workqueue/slow_work_ms.
+ */
+TRACE_EVENT(workqueue_slow_work,
+
+	TP_PROTO(work_func_t func, u64 runtime_ns, u64 latency_ns),
+
+	TP_ARGS(func, runtime_ns, latency_ns),
+
+	TP_STRUCT__entry(
+		__field( void *,	function	)
+		__field( u64,		runtime_ns	)
+		__field( u64,		latency_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->function	= func;
+		__entry->runtime_ns	= runtime_ns;
+		__entry->latency_ns	= latency_ns;
+	),
+
+	TP_printk("function=%pf runtime_ns=%llu latency_ns=%llu",
+		  __entry->function, __entry->runtime_ns, __entry->latency_ns)
+);
+
 #endif /*  _TRACE_WORKQUEUE_H */
 
 /* This part must be outside protection */
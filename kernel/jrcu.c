@@ -59,10 +59,12 @@
 
 #include <linux/bug.h>
 #include <linux/smp.h>
+#include <linux/slab.h>
 #include <linux/ctype.h>
 #include <linux/sched.h>
 #include <linux/types.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/percpu.h>
 #include <linux/stddef.h>
@@ -70,6 +72,7 @@
 #include <linux/preempt.h>
 #include <linux/uaccess.h>
 #include <linux/compiler.h>
+#include <linux/completion.h>
 #include <linux/irqflags.h>
 #include <linux/rcupdate.h>
 
@@ -85,6 +88,8 @@ struct rcu_list {
        struct rcu_head *head;
        struct rcu_head **tail;
        int count;              /* stats-n-debug */
+       u64 stamp;              /* when the oldest entry's batch opened
+                                * (stats-n-debug) */
 };
 
 static inline void rcu_list_init(struct rcu_list *l)
@@ -92,6 +97,7 @@ static inline void rcu_list_init(struct rcu_list *l)
        l->head = NULL;
        l->tail = NULL;
        l->count = 0;
+       l->stamp = 0;
 }
 
 /*
@@ -131,6 +137,12 @@ static inline void rcu_list_join(struct rcu_list *to, struct rcu_list *from)
  */
 static u8 rcu_which ____cacheline_aligned_in_smp;
 
+/*
+ * When each callback list last became the current list.  Used to bound
+ * the latency of the callbacks retired with that list (stats-n-debug).
+ */
+static u64 rcu_batch_stamp[2];
+
 struct rcu_data {
        u8 wait;                /* goes false when this cpu consents to
                                 * the retirement of the current batch */
@@ -150,15 +162,39 @@ static struct rcu_stats {
        atomic_t nsyncs;        /* #rcu syncs processed */
        s64 ninvoked;           /* #invoked (ie, finished) callbacks */
        unsigned nforced;       /* #forced eobs (should be zero) */
+       unsigned nnops;         /* #passes made with nothing queued */
+       unsigned nparks;        /* #times the frame source was parked */
+       s64 noffloaded;         /* #callbacks handed to the offload thread */
+       u64 lat_sum_us;         /* sum of callback latencies, in usecs */
+       u64 lat_max_us;         /* worst callback latency, in usecs */
+       s64 lat_ncbs;           /* #callbacks in lat_sum_us */
 } rcu_stats;
 
 #define RCU_HZ                 (20)
 #define RCU_HZ_PERIOD_US       (USEC_PER_SEC / RCU_HZ)
 #define RCU_HZ_DELTA_US                (USEC_PER_SEC / HZ)
+#define RCU_HZ_MIN_PERIOD_US   (USEC_PER_SEC / 1000)
 
 static int rcu_hz_period_us = RCU_HZ_PERIOD_US;
 static int rcu_hz_delta_us = RCU_HZ_DELTA_US;
 
+/*
+ * The frame period actually in use.  It starts out at rcu_hz_period_us
+ * and is halved for every doubling of the callback backlog beyond
+ * rcu_backlog_lo, down to RCU_HZ_MIN_PERIOD_US.  A zero rcu_backlog_lo
+ * disables the scaling.
+ */
+static int rcu_cur_period_us = RCU_HZ_PERIOD_US;
+static int rcu_backlog_lo = 64;
+
+/*
+ * When nothing is queued anywhere the frame source is parked and stays
+ * parked until some cpu notices, at its next tick, that it has queued
+ * a callback.  rcu_parked is set only while parked.
+ */
+static int rcu_park_enabled = 1;
+static int rcu_parked;
+
 static int rcu_hz_precise;
 
 int rcu_scheduler_active __read_mostly;
@@ -232,6 +268,19 @@ void rcu_note_might_resched(void)
 }
 EXPORT_SYMBOL(rcu_note_might_resched);
 
+struct rcu_synchronize {
+       struct rcu_head head;
+       struct completion completion;
+};
+
+static void wakeme_after_rcu(struct rcu_head *head)
+{
+       struct rcu_synchronize *rcu;
+
+       rcu = container_of(head, struct rcu_synchronize, head);
+       complete(&rcu->completion);
+}
+
 void synchronize_sched(void)
 {
        struct rcu_synchronize rcu;
@@ -260,6 +309,67 @@ void rcu_force_quiescent_state(void)
 }
 EXPORT_SYMBOL_GPL(rcu_force_quiescent_state);
 
+static inline u64 rcu_now(void)
+{
+       return ktime_to_ns(ktime_get());
+}
+
+static inline int rcu_cpu_pending(int cpu)
+{
+       struct rcu_data *rd = &rcu_data[cpu];
+
+       return rd->cblist[0].head || rd->cblist[1].head;
+}
+
+/*
+ * Number of callbacks still waiting for their batch to end.
+ */
+static int rcu_backlog(void)
+{
+       int cpu, backlog = 0;
+
+       for_each_present_cpu(cpu) {
+               struct rcu_data *rd = &rcu_data[cpu];
+               backlog += ACCESS_ONCE(rd->cblist[0].count);
+               backlog += ACCESS_ONCE(rd->cblist[1].count);
+       }
+       return backlog;
+}
+
+static int rcu_frame_period_us(int backlog)
+{
+       int period = rcu_hz_period_us;
+
+       if (rcu_backlog_lo <= 0)
+               return period;
+       while (backlog >= rcu_backlog_lo && period > RCU_HZ_MIN_PERIOD_US) {
+               period >>= 1;
+               backlog >>= 1;
+       }
+       return max_t(int, period, RCU_HZ_MIN_PERIOD_US);
+}
+
+static void rcu_kick(void);
+
+/*
+ * Called from the scheduling-clock interrupt.  If the frame source is
+ * parked and this cpu has queued a callback since, restart it.
+ */
+void rcu_check_callbacks(int cpu, int user)
+{
+       if (unlikely(ACCESS_ONCE(rcu_parked)) && rcu_cpu_pending(cpu))
+               rcu_kick();
+}
+
+/*
+ * Keep the tick of a cpu with queued callbacks going while the frame
+ * source is parked, else they could wait until the cpu leaves idle.
+ */
+int rcu_needs_cpu(int cpu)
+{
+       return ACCESS_ONCE(rcu_parked) && rcu_cpu_pending(cpu);
+}
+
 
 /*
  * Insert an RCU callback onto the calling CPUs list of 'current batch'
@@ -310,6 +420,24 @@ static void rcu_invoke_callbacks(struct rcu_list *pending)
        }
 }
 
+/*
+ * Account the latency of a list of retired callbacks.  The list's stamp
+ * is when the oldest of its batches opened, so this is an upper bound
+ * on the call_rcu() to invocation time of each callback on it.
+ */
+static void rcu_account_latency(struct rcu_list *l)
+{
+       u64 lat;
+
+       if (!l->stamp)
+               return;
+       lat = div_u64(rcu_now() - l->stamp, NSEC_PER_USEC);
+       rcu_stats.lat_sum_us += lat * l->count;
+       rcu_stats.lat_ncbs += l->count;
+       if (lat > rcu_stats.lat_max_us)
+               rcu_stats.lat_max_us = lat;
+}
+
 /*
  * Check if the conditions for ending the current batch are true. If
  * so then end it.
@@ -371,7 +499,7 @@ static void __rcu_delimit_batches(struct rcu_list *pending)
                                        force_cpu_resched(cpu);
                        }
                }
-               rcu_wdog_ctr += rcu_hz_period_us;
+               rcu_wdog_ctr += rcu_cur_period_us;
                return;
        }
 
@@ -388,6 +516,7 @@ static void __rcu_delimit_batches(struct rcu_list *pending)
         * however, cannot exceed one RCU_HZ period.
         */
        prev = ACCESS_ONCE(rcu_which) ^ 1;
+       pending->stamp = rcu_batch_stamp[prev];
 
        for_each_present_cpu(cpu) {
                rd = &rcu_data[cpu];
@@ -412,16 +541,31 @@ static void __rcu_delimit_batches(struct rcu_list *pending)
         * counter until the results of that xchg are visible on other cpus.
         */
        xchg(&rcu_which, prev); /* only place where rcu_which is written to */
+       rcu_batch_stamp[prev] = rcu_now();
 
        rcu_stats.nbatches++;
        rcu_stats.nlast = 0;
        rcu_wdog_ctr = 0;
 }
 
-static void rcu_delimit_batches(void)
+#ifdef CONFIG_JRCU_OFFLOAD
+static int rcu_offload(struct rcu_list *pending);
+#else
+static inline int rcu_offload(struct rcu_list *pending)
+{
+       return 0;
+}
+#endif
+
+/*
+ * Run one frame.  Returns the number of callbacks still waiting for
+ * their batch to end; zero means the frame source may be parked.
+ */
+static int rcu_delimit_batches(void)
 {
        unsigned long flags;
        struct rcu_list pending;
+       int backlog;
 
        rcu_list_init(&pending);
        rcu_stats.npasses++;
@@ -432,8 +576,16 @@ static void rcu_delimit_batches(void)
        smp_mb();
        raw_local_irq_restore(flags);
 
-       if (pending.head)
+       backlog = rcu_backlog();
+       rcu_cur_period_us = rcu_frame_period_us(backlog);
+       if (!backlog && !pending.head)
+               rcu_stats.nnops++;
+
+       if (pending.head && !rcu_offload(&pending)) {
                rcu_invoke_callbacks(&pending);
+               rcu_account_latency(&pending);
+       }
+       return backlog;
 }
 
 /* ------------------ interrupt driver section ------------------ */
@@ -448,7 +600,7 @@ static void rcu_delimit_batches(void)
 #include <linux/hrtimer.h>
 #include <linux/interrupt.h>
 
-#define rcu_hz_period_ns       (rcu_hz_period_us * NSEC_PER_USEC)
+#define rcu_hz_period_ns       (rcu_cur_period_us * NSEC_PER_USEC)
 #define rcu_hz_delta_ns                (rcu_hz_delta_us * NSEC_PER_USEC)
 
 static struct hrtimer rcu_timer;
@@ -498,6 +650,10 @@ void __init rcu_scheduler_starting(void)
 
 #ifndef CONFIG_JRCU_DAEMON
 
+static void rcu_kick(void)
+{
+}
+
 void __init int rcu_start_callback_processing(void)
 {
        rcu_timer_start();
@@ -523,6 +679,37 @@ void __init int rcu_start_callback_processing(void)
 static int rcu_priority;
 static struct task_struct *rcu_daemon;
 
+static void rcu_kick(void)
+{
+       if (xchg(&rcu_parked, 0))
+               wake_up_process(rcu_daemon);
+}
+
+/*
+ * Stop making frames until rcu_kick().  rcu_parked is set before the
+ * final look at the callback lists and call_rcu() queues before its
+ * cpu next looks at rcu_parked, so one side always sees the other.
+ */
+static void rcu_park(void)
+{
+       set_current_state(TASK_INTERRUPTIBLE);
+       ACCESS_ONCE(rcu_parked) = 1;
+       smp_mb();
+       if (rcu_backlog() || kthread_should_stop()) {
+               rcu_parked = 0;
+               __set_current_state(TASK_RUNNING);
+               return;
+       }
+       rcu_stats.nparks++;
+       schedule();
+       __set_current_state(TASK_RUNNING);
+       rcu_parked = 0;
+
+       /* Nothing was queued while parked; don't charge that time. */
+       rcu_batch_stamp[0] = rcu_batch_stamp[1] = rcu_now();
+       rcu_wdog_ctr = 0;
+}
+
 static int jrcu_set_priority(int priority)
 {
        struct sched_param param;
@@ -551,13 +738,14 @@ static int jrcud_func(void *arg)
 
        while (!kthread_should_stop()) {
                if (rcu_hz_precise) {
-                       usleep_range(rcu_hz_period_us,
-                               rcu_hz_period_us);
+                       usleep_range(rcu_cur_period_us,
+                               rcu_cur_period_us);
                } else {
-                       usleep_range(rcu_hz_period_us,
-                               rcu_hz_period_us + rcu_hz_delta_us);
+                       usleep_range(rcu_cur_period_us,
+                               rcu_cur_period_us + rcu_hz_delta_us);
                }
-               rcu_delimit_batches();
+               if (!rcu_delimit_batches() && rcu_park_enabled)
+                       rcu_park();
        }
 
        pr_info("JRCU: replaced callback daemon with a timer.\n");
@@ -567,6 +755,88 @@ static int jrcud_func(void *arg)
        return 0;
 }
 
+#ifdef CONFIG_JRCU_OFFLOAD
+
+/*
+ * Callbacks whose batch has ended are handed to jrcuo rather than being
+ * invoked by jrcud, which may run at a high or realtime priority.  jrcuo
+ * runs SCHED_OTHER at rcu_offload_nice.
+ */
+#include <linux/wait.h>
+#include <linux/spinlock.h>
+
+static int rcu_offload_nice = 5;
+static struct task_struct *rcu_offload_task;
+static struct rcu_list rcu_offload_list;
+static DEFINE_RAW_SPINLOCK(rcu_offload_lock);
+static DECLARE_WAIT_QUEUE_HEAD(rcu_offload_wq);
+
+static int rcu_offload(struct rcu_list *pending)
+{
+       unsigned long flags;
+
+       if (!rcu_offload_task)
+               return 0;
+
+       raw_spin_lock_irqsave(&rcu_offload_lock, flags);
+       if (!rcu_offload_list.head)
+               rcu_offload_list.stamp = pending->stamp;
+       rcu_list_join(&rcu_offload_list, pending);
+       raw_spin_unlock_irqrestore(&rcu_offload_lock, flags);
+
+       rcu_stats.noffloaded += pending->count;
+       wake_up(&rcu_offload_wq);
+       return 1;
+}
+
+static int jrcuo_func(void *arg)
+{
+       struct rcu_list list;
+
+       current->flags |= PF_NOFREEZE;
+       set_user_nice(current, rcu_offload_nice);
+
+       while (!kthread_should_stop()) {
+               wait_event_interruptible(rcu_offload_wq,
+                       ACCESS_ONCE(rcu_offload_list.head) ||
+                       kthread_should_stop());
+
+               raw_spin_lock_irq(&rcu_offload_lock);
+               list = rcu_offload_list;
+               rcu_list_init(&rcu_offload_list);
+               raw_spin_unlock_irq(&rcu_offload_lock);
+
+               if (list.head) {
+                       local_bh_disable();
+                       rcu_invoke_callbacks(&list);
+                       local_bh_enable();
+                       rcu_account_latency(&list);
+               }
+       }
+       return 0;
+}
+
+static void __init rcu_start_offload(void)
+{
+       struct task_struct *p;
+
+       rcu_list_init(&rcu_offload_list);
+       p = kthread_run(jrcuo_func, NULL, "jrcuo");
+       if (IS_ERR(p)) {
+               pr_warn("JRCU: cannot start callback offload thread\n");
+               return;
+       }
+       rcu_offload_task = p;
+}
+
+#else
+
+static inline void rcu_start_offload(void)
+{
+}
+
+#endif /* CONFIG_JRCU_OFFLOAD */
+
 static __init int rcu_start_callback_processing(void)
 {
        struct task_struct *p;
@@ -577,6 +847,7 @@ static __init int rcu_start_callback_processing(void)
                return -ENODEV;
        }
        rcu_daemon = p;
+       rcu_start_offload();
        rcu_scheduler_active = 1;
 
        pr_info("JRCU: callback processing now allowed.\n");
@@ -609,6 +880,14 @@ static int rcu_debugfs_show(struct seq_file *m, void *unused)
                rcu_hz,
                rcu_hz_precise ? "precise" : "sloppy");
 
+       seq_printf(m, "%14d: frame period (usecs), current\n",
+               rcu_cur_period_us);
+       seq_printf(m, "%14d: backlog scaling threshold (0 is off)\n",
+               rcu_backlog_lo);
+       seq_printf(m, "%14s: park when idle%s\n",
+               rcu_park_enabled ? "yes" : "no",
+               ACCESS_ONCE(rcu_parked) ? ", now parked" : "");
+
        seq_printf(m, "%14u: watchdog (secs)\n", rcu_wdog_lim / (int)USEC_PER_SEC);
        seq_printf(m, "%14d: #secs left on watchdog\n",
                (rcu_wdog_lim - rcu_wdog_ctr) / (int)USEC_PER_SEC);
@@ -619,6 +898,12 @@ static int rcu_debugfs_show(struct seq_file *m, void *unused)
        else
                seq_printf(m, "%14s: daemon priority\n", "none, no daemon");
 #endif
+#ifdef CONFIG_JRCU_OFFLOAD
+       if (rcu_offload_task)
+               seq_printf(m, "%14d: offload thread nice\n", rcu_offload_nice);
+       else
+               seq_printf(m, "%14s: offload thread nice\n", "none, no thread");
+#endif
 
        seq_printf(m, "\n");
        seq_printf(m, "%14u: #passes\n",
@@ -633,6 +918,10 @@ static int rcu_debugfs_show(struct seq_file *m, void *unused)
                rcu_stats.nlast);
        seq_printf(m, "%14u: #passes forced (0 is best)\n",
                rcu_stats.nforced);
+       seq_printf(m, "%14u: #passes with nothing queued (NOPs)\n",
+               rcu_stats.nnops);
+       seq_printf(m, "%14u: #times parked while idle\n",
+               rcu_stats.nparks);
 
        seq_printf(m, "\n");
        seq_printf(m, "%14u: #barriers\n",
@@ -643,6 +932,15 @@ static int rcu_debugfs_show(struct seq_file *m, void *unused)
                rcu_stats.ninvoked);
        seq_printf(m, "%14d: #callbacks left to invoke\n",
                (int)(nqueued - rcu_stats.ninvoked));
+#ifdef CONFIG_JRCU_OFFLOAD
+       seq_printf(m, "%14llu: #callbacks offloaded\n",
+               rcu_stats.noffloaded);
+#endif
+       seq_printf(m, "%14llu: avg callback latency (usecs, upper bound)\n",
+               rcu_stats.lat_ncbs ?
+               div64_u64(rcu_stats.lat_sum_us, rcu_stats.lat_ncbs) : 0ULL);
+       seq_printf(m, "%14llu: max callback latency (usecs, upper bound)\n",
+               rcu_stats.lat_max_us);
        seq_printf(m, "\n");
 
        for_each_online_cpu(cpu)
@@ -727,6 +1025,24 @@ next:
                if (wdog < 3 || wdog > 1000)
                        return -EINVAL;
                rcu_wdog_lim = wdog * USEC_PER_SEC;
+       } else if (!strncmp(token, "backlog=", 8)) {
+               int backlog = -1;
+               sscanf(&token[8], "%d", &backlog);
+               if (backlog < 0 || backlog > 1000000)
+                       return -EINVAL;
+               rcu_backlog_lo = backlog;
+       } else if (!strncmp(token, "park=", 5)) {
+               sscanf(&token[5], "%d", &rcu_park_enabled);
+#ifdef CONFIG_JRCU_OFFLOAD
+       } else if (!strncmp(token, "offload_nice=", 13)) {
+               int nice = 100;
+               sscanf(&token[13], "%d", &nice);
+               if (nice < -20 || nice > 19)
+                       return -EINVAL;
+               rcu_offload_nice = nice;
+               if (rcu_offload_task)
+                       set_user_nice(rcu_offload_task, nice);
+#endif
        } else
                return -EINVAL;
        goto next;
@@ -13,10 +13,15 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/timer.h>
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
 
@@ -30,8 +35,28 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Handlers of the same level are run in parallel on early_suspend_wq when
+ * set.  Off by default: existing drivers may rely on registration order
+ * within a level.
+ */
+static bool concurrent;
+module_param(concurrent, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Warn (with a backtrace) about handlers running longer than this, 0: off */
+static unsigned int warn_ms = 200;
+module_param(warn_ms, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
+static struct workqueue_struct *early_suspend_wq;
+
+struct early_suspend_call {
+	struct work_struct work;
+	struct early_suspend *handler;
+	bool resume;
+	struct task_struct *task;
+};
 
 static void early_suspend(struct work_struct *work);
 static DECLARE_WORK(early_suspend_work, early_suspend);
@@ -49,6 +74,149 @@ enum {
 };
 static int state;
 
+static void early_suspend_watchdog(unsigned long data)
+{
+	struct early_suspend_call *call = (struct early_suspend_call *)data;
+	struct early_suspend *h = call->handler;
+
+	pr_warning("%s: %pf is taking more than %u ms\n",
+		   call->resume ? "late_resume" : "early_suspend",
+		   call->resume ? h->resume : h->suspend, warn_ms);
+	show_stack(call->task, NULL);
+}
+
+static void early_suspend_call_one(struct early_suspend_call *call)
+{
+	struct early_suspend *h = call->handler;
+	void (*fn)(struct early_suspend *h) =
+		call->resume ? h->resume : h->suspend;
+	unsigned int ms = warn_ms;
+	struct timer_list timer;
+	ktime_t start;
+	s64 us;
+	u32 d;
+
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("%s: calling %pf\n",
+			call->resume ? "late_resume" : "early_suspend", fn);
+
+	call->task = current;
+	if (ms) {
+		init_timer_on_stack(&timer);
+		timer.function = early_suspend_watchdog;
+		timer.data = (unsigned long)call;
+		mod_timer(&timer, jiffies + msecs_to_jiffies(ms));
+	}
+
+	start = ktime_get();
+	fn(h);
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	if (ms) {
+		del_timer_sync(&timer);
+		destroy_timer_on_stack(&timer);
+		if (us > (s64)ms * USEC_PER_MSEC)
+			pr_warning("%s: %pf took %lld ms\n",
+				   call->resume ? "late_resume" :
+				   "early_suspend", fn, div_s64(us, USEC_PER_MSEC));
+	}
+
+	/* Only this call touches h->stats; readers hold early_suspend_lock */
+	d = min_t(s64, us, (u32)~0U);
+	if (call->resume) {
+		h->stats.resume_count++;
+		h->stats.resume_last = d;
+		h->stats.resume_total += d;
+		if (d > h->stats.resume_max)
+			h->stats.resume_max = d;
+	} else {
+		h->stats.suspend_count++;
+		h->stats.suspend_last = d;
+		h->stats.suspend_total += d;
+		if (d > h->stats.suspend_max)
+			h->stats.suspend_max = d;
+	}
+}
+
+static void early_suspend_call_work(struct work_struct *work)
+{
+	early_suspend_call_one(container_of(work, struct early_suspend_call,
+					    work));
+}
+
+/*
+ * Call every suspend (or, walking backwards, resume) handler, one level at
+ * a time.  With "concurrent" set, the handlers of a level are queued on
+ * early_suspend_wq together and all of them finish before the next level
+ * starts, so the ordering between levels is preserved.
+ * Called with early_suspend_lock held.
+ */
+static void early_suspend_call_handlers(bool resume)
+{
+	struct early_suspend *pos;
+	struct early_suspend_call *calls;
+	int n = 0, i, j, k;
+
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		n++;
+
+	calls = (concurrent && early_suspend_wq) ?
+		kcalloc(n, sizeof(*calls), GFP_KERNEL) : NULL;
+	if (!calls) {
+		struct early_suspend_call call = { .resume = resume };
+
+		if (resume) {
+			list_for_each_entry_reverse(pos,
+					&early_suspend_handlers, link) {
+				if (pos->resume == NULL)
+					continue;
+				call.handler = pos;
+				early_suspend_call_one(&call);
+			}
+		} else {
+			list_for_each_entry(pos,
+					&early_suspend_handlers, link) {
+				if (pos->suspend == NULL)
+					continue;
+				call.handler = pos;
+				early_suspend_call_one(&call);
+			}
+		}
+		return;
+	}
+
+	n = 0;
+	if (resume) {
+		list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
+			if (pos->resume != NULL)
+				calls[n++].handler = pos;
+	} else {
+		list_for_each_entry(pos, &early_suspend_handlers, link)
+			if (pos->suspend != NULL)
+				calls[n++].handler = pos;
+	}
+
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n; j++)
+			if (calls[j].handler->level != calls[i].handler->level)
+				break;
+
+		if (j - i == 1) {
+			calls[i].resume = resume;
+			early_suspend_call_one(&calls[i]);
+			continue;
+		}
+		for (k = i; k < j; k++) {
+			calls[k].resume = resume;
+			INIT_WORK(&calls[k].work, early_suspend_call_work);
+			queue_work(early_suspend_wq, &calls[k].work);
+		}
+		for (k = i; k < j; k++)
+			flush_work(&calls[k].work);
+	}
+	kfree(calls);
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
@@ -61,8 +229,13 @@ void register_early_suspend(struct early_suspend *handler)
 			break;
 	}
 	list_add_tail(&handler->link, pos);
-	if ((state & SUSPENDED) && handler->suspend)
-		handler->suspend(handler);
+	if ((state & SUSPENDED) && handler->suspend) {
+		struct early_suspend_call call = {
+			.handler = handler,
+			.resume = false,
+		};
+		early_suspend_call_one(&call);
+	}
 	mutex_unlock(&early_suspend_lock);
 }
 EXPORT_SYMBOL(register_early_suspend);
@@ -77,7 +250,6 @@ EXPORT_SYMBOL(unregister_early_suspend);
 
 static void early_suspend(struct work_struct *work)
 {
-	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
 
@@ -98,13 +270,7 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
-	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("early_suspend: calling %pf\n", pos->suspend);
-			pos->suspend(pos);
-		}
-	}
+	early_suspend_call_handlers(false);
 	mutex_unlock(&early_suspend_lock);
 
 	suspend_sys_sync_queue();
@@ -119,7 +285,6 @@ abort:
 
 static void late_resume(struct work_struct *work)
 {
-	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
 
@@ -138,14 +303,7 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("late_resume: calling %pf\n", pos->resume);
-
-			pos->resume(pos);
-		}
-	}
+	early_suspend_call_handlers(true);
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -198,3 +356,51 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+static int early_suspend_stats_show(struct seq_file *m, void *unused)
+{
+	struct early_suspend *pos;
+
+	seq_puts(m, "level\tcount\tlast_us\tmax_us\ttotal_us\thandler\n");
+	mutex_lock(&early_suspend_lock);
+	list_for_each_entry(pos, &early_suspend_handlers, link) {
+		if (pos->suspend)
+			seq_printf(m, "%d\t%u\t%u\t%u\t%llu\t%pf\n",
+				   pos->level, pos->stats.suspend_count,
+				   pos->stats.suspend_last,
+				   pos->stats.suspend_max,
+				   pos->stats.suspend_total, pos->suspend);
+		if (pos->resume)
+			seq_printf(m, "%d\t%u\t%u\t%u\t%llu\t%pf\n",
+				   pos->level, pos->stats.resume_count,
+				   pos->stats.resume_last,
+				   pos->stats.resume_max,
+				   pos->stats.resume_total, pos->resume);
+	}
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open = early_suspend_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init early_suspend_init(void)
+{
+	early_suspend_wq = alloc_workqueue("early_suspend", WQ_UNBOUND, 0);
+	if (!early_suspend_wq)
+		pr_err("early_suspend: no workqueue, handlers run serially\n");
+
+	debugfs_create_file("early_suspend_stats", S_IRUGO, NULL, NULL,
+			    &early_suspend_stats_fops);
+	return 0;
+}
+late_initcall(early_suspend_init);
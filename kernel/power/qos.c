@@ -8,11 +8,12 @@
  * This QoS design is best effort based.  Dependents register their QoS needs.
  * Watchers register to keep track of the current QoS needs of the system.
  *
- * There are 3 basic classes of QoS parameter: latency, timeout, throughput
- * each have defined units:
+ * There are 4 basic classes of QoS parameter: latency, timeout, throughput,
+ * frequency each have defined units:
  * latency: usec
  * timeout: usec <-- currently not used.
  * throughput: kbs (kilo byte / sec)
+ * frequency: kHz
  *
  * There are lists of pm_qos_objects each one wrapping requests, notifiers
  *
@@ -104,11 +105,35 @@ static struct pm_qos_object network_throughput_pm_qos = {
 };
 
 
+/* the highest floor wins */
+static BLOCKING_NOTIFIER_HEAD(cpu_freq_min_notifier);
+static struct pm_qos_object cpu_freq_min_pm_qos = {
+	.requests = PLIST_HEAD_INIT(cpu_freq_min_pm_qos.requests),
+	.notifiers = &cpu_freq_min_notifier,
+	.name = "cpu_freq_min",
+	.target_value = PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE,
+	.default_value = PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE,
+	.type = PM_QOS_MAX,
+};
+
+/* the lowest ceiling wins */
+static BLOCKING_NOTIFIER_HEAD(cpu_freq_max_notifier);
+static struct pm_qos_object cpu_freq_max_pm_qos = {
+	.requests = PLIST_HEAD_INIT(cpu_freq_max_pm_qos.requests),
+	.notifiers = &cpu_freq_max_notifier,
+	.name = "cpu_freq_max",
+	.target_value = PM_QOS_CPU_FREQ_MAX_DEFAULT_VALUE,
+	.default_value = PM_QOS_CPU_FREQ_MAX_DEFAULT_VALUE,
+	.type = PM_QOS_MIN,
+};
+
 static struct pm_qos_object *pm_qos_array[] = {
 	&null_pm_qos,
 	&cpu_dma_pm_qos,
 	&network_lat_pm_qos,
-	&network_throughput_pm_qos
+	&network_throughput_pm_qos,
+	&cpu_freq_min_pm_qos,
+	&cpu_freq_max_pm_qos,
 };
 
 static ssize_t pm_qos_power_write(struct file *filp, const char __user *buf,
@@ -476,6 +501,16 @@ static int __init pm_qos_power_init(void)
 			"pm_qos_param: network_throughput setup failed\n");
 		return 0;
 	}
+	ret = register_pm_qos_misc(&cpu_freq_min_pm_qos);
+	if (ret < 0) {
+		printk(KERN_ERR "pm_qos_param: cpu_freq_min setup failed\n");
+		return ret;
+	}
+	ret = register_pm_qos_misc(&cpu_freq_max_pm_qos);
+	if (ret < 0) {
+		printk(KERN_ERR "pm_qos_param: cpu_freq_max setup failed\n");
+		return ret;
+	}
 
 	return ret;
 }
@@ -15,16 +15,100 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/device.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/mutex.h>
 #include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
 #include <linux/syscore_ops.h>
 #include <linux/time.h>
 
 static struct timespec suspend_time_before;
 static unsigned int time_in_suspend_bins[32];
 
+/*
+ * Slowest device suspend and resume callbacks of the last cycle.  The
+ * wall time of dpm_suspend()/dpm_resume() is shown next to the sum of
+ * the callback times, the difference is what async devices overlapped.
+ */
+#define SUSPEND_TIME_DEVS	16
+
+struct suspend_time_dev {
+	char name[32];
+	unsigned int usecs;
+	bool async;
+};
+
+struct suspend_time_phase {
+	struct suspend_time_dev slowest[SUSPEND_TIME_DEVS];
+	int nr_slowest;
+	unsigned int devices;
+	u64 total_usecs;
+	u64 wall_usecs;
+};
+
+static struct suspend_time_phase suspend_time_phases[2];
+static DEFINE_SPINLOCK(suspend_time_dev_lock);
+
+static unsigned int suspend_time_usecs_since(ktime_t starttime)
+{
+	return ktime_to_us(ktime_sub(ktime_get(), starttime));
+}
+
+void suspend_time_dev_begin(bool resume)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&suspend_time_dev_lock, flags);
+	memset(&suspend_time_phases[resume], 0, sizeof(suspend_time_phases[0]));
+	spin_unlock_irqrestore(&suspend_time_dev_lock, flags);
+}
+
+void suspend_time_dev_record(struct device *dev, bool resume, bool async,
+			     ktime_t starttime)
+{
+	struct suspend_time_phase *ph = &suspend_time_phases[resume];
+	unsigned int usecs = suspend_time_usecs_since(starttime);
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&suspend_time_dev_lock, flags);
+	ph->devices++;
+	ph->total_usecs += usecs;
+
+	/* Insertion into the descending slowest[] array. */
+	i = ph->nr_slowest;
+	if (i == SUSPEND_TIME_DEVS) {
+		if (usecs <= ph->slowest[i - 1].usecs)
+			goto out;
+		i--;
+	} else {
+		ph->nr_slowest++;
+	}
+	for (; i > 0 && ph->slowest[i - 1].usecs < usecs; i--)
+		ph->slowest[i] = ph->slowest[i - 1];
+	strlcpy(ph->slowest[i].name, dev_name(dev),
+		sizeof(ph->slowest[i].name));
+	ph->slowest[i].usecs = usecs;
+	ph->slowest[i].async = async;
+ out:
+	spin_unlock_irqrestore(&suspend_time_dev_lock, flags);
+}
+
+void suspend_time_dev_end(bool resume, ktime_t starttime)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&suspend_time_dev_lock, flags);
+	suspend_time_phases[resume].wall_usecs =
+		suspend_time_usecs_since(starttime);
+	spin_unlock_irqrestore(&suspend_time_dev_lock, flags);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static int suspend_time_debug_show(struct seq_file *s, void *data)
 {
@@ -53,6 +137,42 @@ static const struct file_operations suspend_time_debug_fops = {
 	.release	= single_release,
 };
 
+static int suspend_time_devices_show(struct seq_file *s, void *data)
+{
+	static struct suspend_time_phase ph;
+	static DEFINE_MUTEX(show_mutex);
+	int resume, i;
+
+	mutex_lock(&show_mutex);
+	for (resume = 0; resume < 2; resume++) {
+		spin_lock_irq(&suspend_time_dev_lock);
+		ph = suspend_time_phases[resume];
+		spin_unlock_irq(&suspend_time_dev_lock);
+
+		seq_printf(s, "%s: %u devices, wall %llu us, callbacks %llu us\n",
+			   resume ? "resume" : "suspend", ph.devices,
+			   ph.wall_usecs, ph.total_usecs);
+		for (i = 0; i < ph.nr_slowest; i++)
+			seq_printf(s, "  %8u us %s %s\n", ph.slowest[i].usecs,
+				   ph.slowest[i].async ? "async" : "sync ",
+				   ph.slowest[i].name);
+	}
+	mutex_unlock(&show_mutex);
+	return 0;
+}
+
+static int suspend_time_devices_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_time_devices_show, NULL);
+}
+
+static const struct file_operations suspend_time_devices_fops = {
+	.open		= suspend_time_devices_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init suspend_time_debug_init(void)
 {
 	struct dentry *d;
@@ -64,6 +184,13 @@ static int __init suspend_time_debug_init(void)
 		return -ENOMEM;
 	}
 
+	d = debugfs_create_file("suspend_time_devices", 0444, NULL, NULL,
+		&suspend_time_devices_fops);
+	if (!d) {
+		pr_err("Failed to create suspend_time_devices debug file\n");
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
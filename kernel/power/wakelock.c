@@ -18,7 +18,13 @@
 #include <linux/rtc.h>
 #include <linux/suspend.h>
 #include <linux/syscalls.h> /* sys_sync */
+#include <linux/backing-dev.h>
+#include <linux/vmstat.h>
 #include <linux/wakelock.h>
+#include <linux/rbtree.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #ifdef CONFIG_WAKELOCK_STAT
 #include <linux/proc_fs.h>
 #endif
@@ -43,6 +49,22 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+/*
+ * has_wake_lock_locked() must not walk the active lists: locks held
+ * without a timeout are only counted, locks held with a timeout are
+ * kept in an rb-tree ordered by expiry.
+ */
+static int active_untimed_locks[WAKE_LOCK_TYPE_COUNT];
+static struct rb_root expire_tree[WAKE_LOCK_TYPE_COUNT];
+
+/* Per-CPU so that counting never touches a shared cache line. */
+struct wake_lock_op_stats {
+	unsigned long lock;
+	unsigned long unlock;
+	unsigned long expire;
+	unsigned long contended;
+};
+static DEFINE_PER_CPU(struct wake_lock_op_stats, wake_lock_op_stats);
 static int current_event_num;
 static int suspend_sys_sync_count;
 static DEFINE_SPINLOCK(suspend_sys_sync_lock);
@@ -199,14 +221,56 @@ static void update_sleep_wait_stats_locked(int done)
 #endif
 
 
+static unsigned long list_lock_irqsave(void)
+{
+	unsigned long irqflags;
+
+	if (!spin_trylock_irqsave(&list_lock, irqflags)) {
+		this_cpu_inc(wake_lock_op_stats.contended);
+		spin_lock_irqsave(&list_lock, irqflags);
+	}
+	return irqflags;
+}
+
+static void expire_tree_insert(struct wake_lock *lock, int type)
+{
+	struct rb_node **p = &expire_tree[type].rb_node;
+	struct rb_node *parent = NULL;
+	struct wake_lock *l;
+
+	while (*p) {
+		parent = *p;
+		l = rb_entry(parent, struct wake_lock, expire_node);
+		if (time_before(lock->expires, l->expires))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&lock->expire_node, parent, p);
+	rb_insert_color(&lock->expire_node, &expire_tree[type]);
+}
+
+/* Drop an active lock from the untimed count or the expire tree. */
+static void wake_lock_deactivate_locked(struct wake_lock *lock, int type)
+{
+	if (!(lock->flags & WAKE_LOCK_ACTIVE))
+		return;
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		rb_erase(&lock->expire_node, &expire_tree[type]);
+	else
+		active_untimed_locks[type]--;
+}
+
 static void expire_wake_lock(struct wake_lock *lock)
 {
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
+	wake_lock_deactivate_locked(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
+	this_cpu_inc(wake_lock_op_stats.expire);
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
 }
@@ -236,28 +300,33 @@ static void print_active_locks(int type)
 
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct rb_node *node;
+	struct wake_lock *lock;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	if (active_untimed_locks[type])
+		return -1;
+
+	/* Only the locks that have already expired are visited. */
+	while ((node = rb_first(&expire_tree[type]))) {
+		lock = rb_entry(node, struct wake_lock, expire_node);
+		if ((long)(lock->expires - jiffies) > 0)
+			break;
+		expire_wake_lock(lock);
 	}
-	return max_timeout;
+
+	node = rb_last(&expire_tree[type]);
+	if (!node)
+		return 0;
+	lock = rb_entry(node, struct wake_lock, expire_node);
+	return lock->expires - jiffies;
 }
 
 long has_wake_lock(int type)
 {
 	long ret;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
+	irqflags = list_lock_irqsave();
 	ret = has_wake_lock_locked(type);
 	if (ret && (debug_mask & DEBUG_WAKEUP) && type == WAKE_LOCK_SUSPEND)
 		print_active_locks(type);
@@ -265,18 +334,70 @@ long has_wake_lock(int type)
 	return ret;
 }
 
+/* Skip the pre-suspend sync when nothing is dirty. */
+static int sys_sync_skip_clean = 1;
+module_param(sys_sync_skip_clean, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/*
+ * Give up on a suspend attempt when the sync takes longer than this
+ * (0: wait for it).  The sync itself keeps going in the background.
+ */
+static unsigned int sys_sync_timeout_ms;
+module_param(sys_sync_timeout_ms, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Protected by suspend_sys_sync_lock, except timeouts */
+static struct {
+	unsigned int queued;
+	unsigned int skipped;
+	unsigned int timeouts;
+	ktime_t total_time;
+	ktime_t max_time;
+	ktime_t last_time;
+} suspend_sys_sync_stats;
+
+static bool suspend_sys_sync_needed(void)
+{
+	struct backing_dev_info *bdi;
+	bool dirty = false;
+
+	if (global_page_state(NR_FILE_DIRTY) ||
+	    global_page_state(NR_WRITEBACK) ||
+	    global_page_state(NR_UNSTABLE_NFS))
+		return true;
+
+	/* Dirty inodes without dirty pages, e.g. after a chmod. */
+	rcu_read_lock();
+	list_for_each_entry_rcu(bdi, &bdi_list, bdi_list) {
+		if (bdi_has_dirty_io(bdi)) {
+			dirty = true;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	return dirty;
+}
+
 static void suspend_sys_sync(struct work_struct *work)
 {
+	ktime_t start, duration;
+
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("PM: Syncing filesystems...\n");
 
+	start = ktime_get();
 	sys_sync();
+	duration = ktime_sub(ktime_get(), start);
 
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("sync done.\n");
+		pr_info("sync done in %lld ms.\n", ktime_to_ms(duration));
 
 	spin_lock(&suspend_sys_sync_lock);
 	suspend_sys_sync_count--;
+	suspend_sys_sync_stats.last_time = duration;
+	suspend_sys_sync_stats.total_time =
+		ktime_add(suspend_sys_sync_stats.total_time, duration);
+	if (duration.tv64 > suspend_sys_sync_stats.max_time.tv64)
+		suspend_sys_sync_stats.max_time = duration;
 	spin_unlock(&suspend_sys_sync_lock);
 }
 static DECLARE_WORK(suspend_sys_sync_work, suspend_sys_sync);
@@ -285,14 +406,26 @@ void suspend_sys_sync_queue(void)
 {
 	int ret;
 
+	if (sys_sync_skip_clean && !suspend_sys_sync_needed()) {
+		if (debug_mask & DEBUG_SUSPEND)
+			pr_info("PM: nothing dirty, skipping sync\n");
+		spin_lock(&suspend_sys_sync_lock);
+		suspend_sys_sync_stats.skipped++;
+		spin_unlock(&suspend_sys_sync_lock);
+		return;
+	}
+
 	spin_lock(&suspend_sys_sync_lock);
 	ret = queue_work(suspend_sys_sync_work_queue, &suspend_sys_sync_work);
-	if (ret)
+	if (ret) {
 		suspend_sys_sync_count++;
+		suspend_sys_sync_stats.queued++;
+	}
 	spin_unlock(&suspend_sys_sync_lock);
 }
 
 static bool suspend_sys_sync_abort;
+static unsigned long suspend_sys_sync_deadline;
 static void suspend_sys_sync_handler(unsigned long);
 static DEFINE_TIMER(suspend_sys_sync_timer, suspend_sys_sync_handler, 0, 0);
 /* value should be less then half of input event wake lock timeout value
@@ -306,6 +439,14 @@ static void suspend_sys_sync_handler(unsigned long arg)
 	} else if (has_wake_lock(WAKE_LOCK_SUSPEND)) {
 		suspend_sys_sync_abort = true;
 		complete(&suspend_sys_sync_comp);
+	} else if (sys_sync_timeout_ms &&
+		   time_after_eq(jiffies, suspend_sys_sync_deadline)) {
+		pr_info("suspend: sys_sync still running after %u ms\n",
+			sys_sync_timeout_ms);
+		/* only written here, the lock is not softirq safe */
+		suspend_sys_sync_stats.timeouts++;
+		suspend_sys_sync_abort = true;
+		complete(&suspend_sys_sync_comp);
 	} else {
 		mod_timer(&suspend_sys_sync_timer, jiffies +
 				SUSPEND_SYS_SYNC_TIMEOUT);
@@ -315,6 +456,8 @@ static void suspend_sys_sync_handler(unsigned long arg)
 int suspend_sys_sync_wait(void)
 {
 	suspend_sys_sync_abort = false;
+	suspend_sys_sync_deadline = jiffies +
+		msecs_to_jiffies(sys_sync_timeout_ms);
 
 	if (suspend_sys_sync_count != 0) {
 		mod_timer(&suspend_sys_sync_timer, jiffies +
@@ -459,7 +602,9 @@ void wake_lock_destroy(struct wake_lock *lock)
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
-	lock->flags &= ~WAKE_LOCK_INITIALIZED;
+	wake_lock_deactivate_locked(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
+	lock->flags &= ~(WAKE_LOCK_INITIALIZED | WAKE_LOCK_ACTIVE |
+			 WAKE_LOCK_AUTO_EXPIRE);
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
 		deleted_wake_locks.stat.count += lock->stat.count;
@@ -487,7 +632,8 @@ static void wake_lock_internal(
 	unsigned long irqflags;
 	long expire_in;
 
-	spin_lock_irqsave(&list_lock, irqflags);
+	irqflags = list_lock_irqsave();
+	this_cpu_inc(wake_lock_op_stats.lock);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
@@ -505,11 +651,13 @@ static void wake_lock_internal(
 	}
 #endif
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
-		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
 		lock->stat.last_time = ktime_get();
 #endif
+	} else {
+		wake_lock_deactivate_locked(lock, type);
 	}
+	lock->flags |= WAKE_LOCK_ACTIVE;
 	list_del(&lock->link);
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
@@ -519,12 +667,14 @@ static void wake_lock_internal(
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
 		list_add_tail(&lock->link, &active_wake_locks[type]);
+		expire_tree_insert(lock, type);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
 		list_add(&lock->link, &active_wake_locks[type]);
+		active_untimed_locks[type]++;
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
@@ -571,13 +721,15 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
+	irqflags = list_lock_irqsave();
+	this_cpu_inc(wake_lock_op_stats.unlock);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 0);
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	wake_lock_deactivate_locked(lock, type);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
@@ -627,13 +779,89 @@ static const struct file_operations wakelock_stats_fops = {
 	.release = single_release,
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int wakelock_ops_show(struct seq_file *m, void *unused)
+{
+	struct wake_lock_op_stats *st;
+	int cpu;
+
+	seq_puts(m, "cpu\tlock\tunlock\texpire\tcontended\n");
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(wake_lock_op_stats, cpu);
+		seq_printf(m, "%d\t%lu\t%lu\t%lu\t%lu\n", cpu, st->lock,
+			   st->unlock, st->expire, st->contended);
+	}
+	return 0;
+}
+
+static int wakelock_ops_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakelock_ops_show, NULL);
+}
+
+static const struct file_operations wakelock_ops_fops = {
+	.owner = THIS_MODULE,
+	.open = wakelock_ops_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int suspend_sys_sync_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned int queued, skipped, timeouts;
+	ktime_t total, max, last;
+
+	spin_lock(&suspend_sys_sync_lock);
+	queued = suspend_sys_sync_stats.queued;
+	skipped = suspend_sys_sync_stats.skipped;
+	timeouts = suspend_sys_sync_stats.timeouts;
+	total = suspend_sys_sync_stats.total_time;
+	max = suspend_sys_sync_stats.max_time;
+	last = suspend_sys_sync_stats.last_time;
+	spin_unlock(&suspend_sys_sync_lock);
+
+	seq_printf(m, "synced\t%u\nskipped\t%u\ntimeouts\t%u\n"
+		   "total_ms\t%lld\nmax_ms\t%lld\nlast_ms\t%lld\n",
+		   queued, skipped, timeouts, ktime_to_ms(total),
+		   ktime_to_ms(max), ktime_to_ms(last));
+	return 0;
+}
+
+static int suspend_sys_sync_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_sys_sync_stats_show, NULL);
+}
+
+static const struct file_operations suspend_sys_sync_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = suspend_sys_sync_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* debugfs is not up yet when wakelocks_init() runs */
+static int __init wakelock_debugfs_init(void)
+{
+	debugfs_create_file("wakelock_ops", S_IRUGO, NULL, NULL,
+			    &wakelock_ops_fops);
+	debugfs_create_file("suspend_sys_sync", S_IRUGO, NULL, NULL,
+			    &suspend_sys_sync_stats_fops);
+	return 0;
+}
+late_initcall(wakelock_debugfs_init);
+#endif
+
 static int __init wakelocks_init(void)
 {
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
 		INIT_LIST_HEAD(&active_wake_locks[i]);
+		expire_tree[i] = RB_ROOT;
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -0,0 +1,226 @@
+/* kernel/power/wakelock_bench.c
+ *
+ * Microbenchmark for wake_lock()/wake_unlock() under contention.
+ *
+ * On load, starts one thread per online CPU (or "threads") that
+ * repeatedly locks and unlocks its own set of suspend wake locks while
+ * "background" other locks are held with a long timeout, then reports
+ * the average cost of a lock/unlock pair.  Compare the output with
+ * the "contended" column of /sys/kernel/debug/wakelock_ops.
+ *
+ *	insmod wakelock_bench.ko threads=2 iterations=100000 background=64
+ *	dmesg | grep wakelock_bench
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/hrtimer.h>
+#include <linux/slab.h>
+#include <linux/wakelock.h>
+
+static int threads;
+module_param(threads, int, 0444);
+MODULE_PARM_DESC(threads, "Benchmark threads (0: one per online CPU)");
+
+static int locks_per_thread = 4;
+module_param(locks_per_thread, int, 0444);
+MODULE_PARM_DESC(locks_per_thread, "Wake locks cycled by each thread");
+
+static int iterations = 100000;
+module_param(iterations, int, 0444);
+MODULE_PARM_DESC(iterations, "Lock/unlock pairs per thread");
+
+static int timeout_pct;
+module_param(timeout_pct, int, 0444);
+MODULE_PARM_DESC(timeout_pct, "Percentage of locks taken with a timeout");
+
+static int background = 16;
+module_param(background, int, 0444);
+MODULE_PARM_DESC(background, "Other wake locks held with a timeout");
+
+#define BENCH_HOLD_TIMEOUT	(60 * HZ)
+
+struct bench_thread {
+	struct task_struct *task;
+	struct wake_lock *locks;
+	s64 elapsed_ns;
+};
+
+static struct bench_thread *bench;
+static int nr_bench;		/* entries of bench[] with locks set up */
+static struct wake_lock *bg_locks;
+static int nr_bg_locks;
+static bool bench_abort;
+static atomic_t bench_ready;
+static DECLARE_COMPLETION(bench_go);
+static DECLARE_COMPLETION(bench_done);
+static atomic_t bench_running;
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *bt = data;
+	ktime_t start;
+	int i;
+
+	atomic_inc(&bench_ready);
+	wait_for_completion(&bench_go);
+
+	start = ktime_get();
+	for (i = 0; i < iterations && !bench_abort; i++) {
+		struct wake_lock *lock = &bt->locks[i % locks_per_thread];
+
+		if (i % 100 < timeout_pct)
+			wake_lock_timeout(lock, BENCH_HOLD_TIMEOUT);
+		else
+			wake_lock(lock);
+		wake_unlock(lock);
+	}
+	bt->elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_dec_and_test(&bench_running))
+		complete(&bench_done);
+
+	/* Stay around until wakelock_bench_exit() stops us. */
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+	return 0;
+}
+
+static void wakelock_bench_report(void)
+{
+	s64 total = 0, worst = 0;
+	int t;
+
+	for (t = 0; t < threads; t++) {
+		total += bench[t].elapsed_ns;
+		if (bench[t].elapsed_ns > worst)
+			worst = bench[t].elapsed_ns;
+	}
+	pr_info("wakelock_bench: threads %d iterations %d locks %d "
+		"timeout_pct %d background %d\n", threads, iterations,
+		locks_per_thread, timeout_pct, background);
+	pr_info("wakelock_bench: avg %lld ns/pair, slowest thread %lld ms\n",
+		div_s64(total, (s64)threads * iterations),
+		div_s64(worst, NSEC_PER_MSEC));
+}
+
+static void wakelock_bench_free(void)
+{
+	int t, i;
+
+	for (t = 0; t < nr_bench; t++) {
+		if (bench[t].task)
+			kthread_stop(bench[t].task);
+		for (i = 0; i < locks_per_thread; i++) {
+			wake_unlock(&bench[t].locks[i]);
+			wake_lock_destroy(&bench[t].locks[i]);
+		}
+		kfree(bench[t].locks);
+	}
+	kfree(bench);
+
+	for (i = 0; i < nr_bg_locks; i++) {
+		wake_unlock(&bg_locks[i]);
+		wake_lock_destroy(&bg_locks[i]);
+	}
+	kfree(bg_locks);
+}
+
+static int __init wakelock_bench_init(void)
+{
+	int t, i, cpu;
+	int ret = -ENOMEM;
+
+	if (threads <= 0)
+		threads = num_online_cpus();
+	if (locks_per_thread <= 0 || iterations <= 0 || background < 0 ||
+	    timeout_pct < 0 || timeout_pct > 100)
+		return -EINVAL;
+
+	bench = kcalloc(threads, sizeof(*bench), GFP_KERNEL);
+	if (!bench)
+		return -ENOMEM;
+
+	if (background) {
+		bg_locks = kcalloc(background, sizeof(*bg_locks), GFP_KERNEL);
+		if (!bg_locks)
+			goto err_free;
+		for (i = 0; i < background; i++) {
+			wake_lock_init(&bg_locks[i], WAKE_LOCK_SUSPEND,
+				       "wakelock_bench_bg");
+			wake_lock_timeout(&bg_locks[i],
+					  BENCH_HOLD_TIMEOUT + i);
+		}
+		nr_bg_locks = background;
+	}
+
+	for (t = 0; t < threads; t++) {
+		bench[t].locks = kcalloc(locks_per_thread,
+					 sizeof(*bench[t].locks), GFP_KERNEL);
+		if (!bench[t].locks)
+			goto err_free;
+		for (i = 0; i < locks_per_thread; i++)
+			wake_lock_init(&bench[t].locks[i], WAKE_LOCK_SUSPEND,
+				       "wakelock_bench");
+		nr_bench++;
+	}
+
+	atomic_set(&bench_running, threads);
+	cpu = cpumask_first(cpu_online_mask);
+	for (t = 0; t < threads; t++) {
+		bench[t].task = kthread_create(bench_thread_fn, &bench[t],
+					       "wakelock_bench/%d", t);
+		if (IS_ERR(bench[t].task)) {
+			ret = PTR_ERR(bench[t].task);
+			bench[t].task = NULL;
+			bench_abort = true;
+			complete_all(&bench_go);
+			goto err_free;
+		}
+		kthread_bind(bench[t].task, cpu);
+		wake_up_process(bench[t].task);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+
+	while (atomic_read(&bench_ready) < threads)
+		schedule_timeout_uninterruptible(1);
+	complete_all(&bench_go);
+	wait_for_completion(&bench_done);
+
+	wakelock_bench_report();
+	return 0;
+
+err_free:
+	wakelock_bench_free();
+	return ret;
+}
+
+static void __exit wakelock_bench_exit(void)
+{
+	wakelock_bench_free();
+}
+
+module_init(wakelock_bench_init);
+module_exit(wakelock_bench_exit);
+
+MODULE_DESCRIPTION("wake_lock/wake_unlock microbenchmark");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,511 @@
+/*
+ * Read-Copy Update module-based performance measurement facility
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Measures the RCU implementation the kernel was built with, so that
+ * runs on kernels built with different RCU implementations can be
+ * compared line for line.
+ *
+ * See also:  Documentation/RCU/perf.txt
+ */
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <asm/atomic.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+
+MODULE_LICENSE("GPL");
+
+static int nreaders = -1;	/* # reader threads, defaults to ncpus */
+static int nupdaters = 1;	/* # updater threads */
+static int duration = 5;	/* Length of each phase, in seconds. */
+static int gp_interval_us = 1000; /* Pacing of the gp phase callbacks. */
+static int max_outstanding = 10000; /* Callback bound in the flood phase. */
+
+module_param(nreaders, int, 0444);
+MODULE_PARM_DESC(nreaders, "Number of RCU reader threads");
+module_param(nupdaters, int, 0444);
+MODULE_PARM_DESC(nupdaters, "Number of RCU updater threads");
+module_param(duration, int, 0444);
+MODULE_PARM_DESC(duration, "Length of each test phase (s)");
+module_param(gp_interval_us, int, 0444);
+MODULE_PARM_DESC(gp_interval_us, "Delay between gp phase call_rcu()s (us)");
+module_param(max_outstanding, int, 0444);
+MODULE_PARM_DESC(max_outstanding, "Callbacks in flight during flood phase");
+
+#if defined(CONFIG_JRCU)
+#define RCUPERF_FLAVOR "jrcu"
+#elif defined(CONFIG_TINY_PREEMPT_RCU)
+#define RCUPERF_FLAVOR "tiny_preempt"
+#elif defined(CONFIG_TINY_RCU)
+#define RCUPERF_FLAVOR "tiny"
+#elif defined(CONFIG_TREE_PREEMPT_RCU)
+#define RCUPERF_FLAVOR "tree_preempt"
+#else
+#define RCUPERF_FLAVOR "tree"
+#endif
+
+#define PERF_FLAG "rcuperf: " RCUPERF_FLAVOR ": "
+
+/*
+ * The test runs as a sequence of phases.  Readers run throughout; each
+ * phase starts its own updaters.
+ */
+enum rcuperf_phase {
+	RCUPERF_READ,		/* readers only */
+	RCUPERF_SYNC,		/* updaters replace and synchronize_rcu() */
+	RCUPERF_GP,		/* updaters post paced call_rcu()s */
+	RCUPERF_FLOOD,		/* updaters post call_rcu()s flat out */
+	RCUPERF_NR_PHASES,
+};
+
+static const char * const rcuperf_phase_names[] = {
+	"read", "sync", "gp", "flood",
+};
+
+static int rcuperf_phase;
+
+/* Latency accumulator, in nanoseconds. */
+struct rcuperf_lat {
+	spinlock_t lock;
+	u64 n;
+	u64 sum;
+	u64 min;
+	u64 max;
+};
+
+struct rcuperf_reader {
+	struct task_struct *task;
+	u64 nreads[RCUPERF_NR_PHASES];
+	u64 ns[RCUPERF_NR_PHASES];
+};
+
+struct rcuperf_updater {
+	struct task_struct *task;
+	struct rcuperf_lat lat;
+	u64 nqueued;
+};
+
+struct rcuperf_elem {
+	struct rcu_head rcu;
+	u64 stamp;
+	struct rcuperf_updater *u;
+	int val;
+};
+
+static struct rcuperf_elem __rcu *rcuperf_ptr;
+static DEFINE_SPINLOCK(rcuperf_ptr_lock);
+
+static struct task_struct *rcuperf_task;
+static struct rcuperf_reader *readers;
+static struct rcuperf_updater *updaters;
+
+static atomic_t n_outstanding;
+static atomic_long_t n_invoked;
+
+static int rcuperf_sink;
+
+#define RCUPERF_READ_LOOPS	1000
+
+static inline u64 rcuperf_now(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+static void rcuperf_lat_init(struct rcuperf_lat *l)
+{
+	spin_lock_init(&l->lock);
+	l->n = l->sum = l->max = 0;
+	l->min = ULLONG_MAX;
+}
+
+static void rcuperf_lat_add(struct rcuperf_lat *l, u64 ns)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&l->lock, flags);
+	l->n++;
+	l->sum += ns;
+	if (ns < l->min)
+		l->min = ns;
+	if (ns > l->max)
+		l->max = ns;
+	spin_unlock_irqrestore(&l->lock, flags);
+}
+
+static void rcuperf_lat_fold(struct rcuperf_lat *to, struct rcuperf_lat *from)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&from->lock, flags);
+	to->n += from->n;
+	to->sum += from->sum;
+	if (from->min < to->min)
+		to->min = from->min;
+	if (from->max > to->max)
+		to->max = from->max;
+	spin_unlock_irqrestore(&from->lock, flags);
+}
+
+/*
+ * Cost of the reader loop without the read-side primitives, so that it
+ * can be subtracted from the measured read-side cost.
+ */
+static u64 rcuperf_empty_loop_ns(void)
+{
+	u64 start, ns = 0, n = 0;
+	int i, sum = 0;
+
+	while (n < 100 * RCUPERF_READ_LOOPS) {
+		struct rcuperf_elem *p;
+
+		start = rcuperf_now();
+		for (i = 0; i < RCUPERF_READ_LOOPS; i++) {
+			barrier();
+			p = ACCESS_ONCE(rcuperf_ptr);
+			if (p)
+				sum += p->val;
+			barrier();
+		}
+		ns += rcuperf_now() - start;
+		n += RCUPERF_READ_LOOPS;
+		cond_resched();
+	}
+	ACCESS_ONCE(rcuperf_sink) = sum;
+	return div64_u64(ns, n);
+}
+
+static int rcuperf_reader(void *arg)
+{
+	struct rcuperf_reader *r = arg;
+	int i, phase, sum = 0;
+	u64 start, ns;
+
+	do {
+		start = rcuperf_now();
+		for (i = 0; i < RCUPERF_READ_LOOPS; i++) {
+			struct rcuperf_elem *p;
+
+			rcu_read_lock();
+			p = rcu_dereference(rcuperf_ptr);
+			if (p)
+				sum += p->val;
+			rcu_read_unlock();
+		}
+		ns = rcuperf_now() - start;
+		phase = ACCESS_ONCE(rcuperf_phase);
+		r->nreads[phase] += RCUPERF_READ_LOOPS;
+		r->ns[phase] += ns;
+		cond_resched();
+	} while (!kthread_should_stop());
+
+	ACCESS_ONCE(rcuperf_sink) = sum;
+	return 0;
+}
+
+static struct rcuperf_elem *rcuperf_alloc(struct rcuperf_updater *u)
+{
+	struct rcuperf_elem *p;
+
+	p = kmalloc(sizeof(*p), GFP_KERNEL);
+	if (p) {
+		p->u = u;
+		p->val = 1;
+	}
+	return p;
+}
+
+static int rcuperf_sync(void *arg)
+{
+	struct rcuperf_updater *u = arg;
+	struct rcuperf_elem *new, *old;
+	u64 start;
+
+	do {
+		new = rcuperf_alloc(u);
+		if (!new) {
+			schedule_timeout_uninterruptible(1);
+			continue;
+		}
+		spin_lock(&rcuperf_ptr_lock);
+		old = rcu_dereference_protected(rcuperf_ptr,
+				lockdep_is_held(&rcuperf_ptr_lock));
+		rcu_assign_pointer(rcuperf_ptr, new);
+		spin_unlock(&rcuperf_ptr_lock);
+
+		start = rcuperf_now();
+		synchronize_rcu();
+		rcuperf_lat_add(&u->lat, rcuperf_now() - start);
+		kfree(old);
+		u->nqueued++;
+	} while (!kthread_should_stop());
+	return 0;
+}
+
+static void rcuperf_gp_cb(struct rcu_head *rcu)
+{
+	struct rcuperf_elem *p = container_of(rcu, struct rcuperf_elem, rcu);
+
+	rcuperf_lat_add(&p->u->lat, rcuperf_now() - p->stamp);
+	atomic_long_inc(&n_invoked);
+	atomic_dec(&n_outstanding);
+	kfree(p);
+}
+
+static int rcuperf_gp(void *arg)
+{
+	struct rcuperf_updater *u = arg;
+	struct rcuperf_elem *p;
+
+	do {
+		p = rcuperf_alloc(u);
+		if (p) {
+			atomic_inc(&n_outstanding);
+			p->stamp = rcuperf_now();
+			call_rcu(&p->rcu, rcuperf_gp_cb);
+			u->nqueued++;
+		}
+		usleep_range(gp_interval_us, gp_interval_us + gp_interval_us / 8);
+	} while (!kthread_should_stop());
+	return 0;
+}
+
+static int rcuperf_flood(void *arg)
+{
+	struct rcuperf_updater *u = arg;
+	struct rcuperf_elem *p;
+
+	do {
+		if (atomic_read(&n_outstanding) >= max_outstanding) {
+			schedule_timeout_uninterruptible(1);
+			continue;
+		}
+		p = rcuperf_alloc(u);
+		if (!p) {
+			schedule_timeout_uninterruptible(1);
+			continue;
+		}
+		atomic_inc(&n_outstanding);
+		p->stamp = rcuperf_now();
+		call_rcu(&p->rcu, rcuperf_gp_cb);
+		u->nqueued++;
+		cond_resched();
+	} while (!kthread_should_stop());
+	return 0;
+}
+
+static int (*rcuperf_updater_fns[])(void *) = {
+	[RCUPERF_SYNC]	= rcuperf_sync,
+	[RCUPERF_GP]	= rcuperf_gp,
+	[RCUPERF_FLOOD]	= rcuperf_flood,
+};
+
+static void rcuperf_stop_threads(struct task_struct **task)
+{
+	if (*task) {
+		kthread_stop(*task);
+		*task = NULL;
+	}
+}
+
+static int rcuperf_print_readers(int phase, u64 base_ns)
+{
+	u64 nreads = 0, ns = 0, per;
+	int i;
+
+	for (i = 0; i < nreaders; i++) {
+		nreads += readers[i].nreads[phase];
+		ns += readers[i].ns[phase];
+	}
+	if (!nreads)
+		return 0;
+	per = div64_u64(ns, nreads);
+	printk(KERN_ALERT PERF_FLAG
+	       "%s: reads=%llu read_ns=%llu overhead_ns=%llu\n",
+	       rcuperf_phase_names[phase], nreads, per,
+	       per > base_ns ? per - base_ns : 0ULL);
+	return 1;
+}
+
+/*
+ * Run one phase with its updaters and report on it.  Returns nonzero if
+ * the test was cut short by module unload.
+ */
+static int rcuperf_run_phase(int phase, u64 base_ns)
+{
+	struct rcuperf_lat lat;
+	u64 nqueued = 0, start, barrier_ns;
+	long invoked;
+	int i, stopped;
+
+	atomic_long_set(&n_invoked, 0);
+	for (i = 0; i < nupdaters && phase != RCUPERF_READ; i++) {
+		struct rcuperf_updater *u = &updaters[i];
+
+		rcuperf_lat_init(&u->lat);
+		u->nqueued = 0;
+		u->task = kthread_run(rcuperf_updater_fns[phase], u,
+				      "rcuperf_%s", rcuperf_phase_names[phase]);
+		if (IS_ERR(u->task)) {
+			u->task = NULL;
+			printk(KERN_ALERT PERF_FLAG "cannot start updater\n");
+		}
+	}
+	ACCESS_ONCE(rcuperf_phase) = phase;
+
+	start = rcuperf_now();
+	schedule_timeout_interruptible(duration * HZ);
+	stopped = kthread_should_stop();
+	start = rcuperf_now() - start;
+
+	for (i = 0; i < nupdaters; i++)
+		rcuperf_stop_threads(&updaters[i].task);
+	invoked = atomic_long_read(&n_invoked);
+
+	barrier_ns = rcuperf_now();
+	rcu_barrier();
+	barrier_ns = rcuperf_now() - barrier_ns;
+
+	rcuperf_print_readers(phase, base_ns);
+	if (phase == RCUPERF_READ)
+		return stopped;
+
+	rcuperf_lat_init(&lat);
+	for (i = 0; i < nupdaters; i++) {
+		rcuperf_lat_fold(&lat, &updaters[i].lat);
+		nqueued += updaters[i].nqueued;
+	}
+	if (!lat.n)
+		lat.min = 0;
+
+	switch (phase) {
+	case RCUPERF_SYNC:
+		printk(KERN_ALERT PERF_FLAG "sync: calls=%llu "
+		       "avg_us=%llu min_us=%llu max_us=%llu\n",
+		       lat.n, div64_u64(lat.sum, max_t(u64, lat.n, 1)) / 1000,
+		       lat.min / 1000, lat.max / 1000);
+		break;
+	case RCUPERF_GP:
+		printk(KERN_ALERT PERF_FLAG "gp: callbacks=%llu "
+		       "avg_us=%llu min_us=%llu max_us=%llu\n",
+		       lat.n, div64_u64(lat.sum, max_t(u64, lat.n, 1)) / 1000,
+		       lat.min / 1000, lat.max / 1000);
+		break;
+	case RCUPERF_FLOOD:
+		printk(KERN_ALERT PERF_FLAG "flood: queued_per_s=%llu "
+		       "invoked_per_s=%llu avg_lat_us=%llu max_lat_us=%llu "
+		       "barrier_us=%llu\n",
+		       div64_u64(nqueued * NSEC_PER_SEC, max_t(u64, start, 1)),
+		       div64_u64((u64)invoked * NSEC_PER_SEC,
+				 max_t(u64, start, 1)),
+		       div64_u64(lat.sum, max_t(u64, lat.n, 1)) / 1000,
+		       lat.max / 1000, barrier_ns / 1000);
+		break;
+	}
+	return stopped;
+}
+
+static int rcuperf_main(void *arg)
+{
+	struct rcuperf_elem *p;
+	u64 base_ns;
+	int i, phase;
+
+	base_ns = rcuperf_empty_loop_ns();
+	printk(KERN_ALERT PERF_FLAG "start: nreaders=%d nupdaters=%d "
+	       "duration=%d empty_loop_ns=%llu\n",
+	       nreaders, nupdaters, duration, base_ns);
+
+	for (i = 0; i < nreaders; i++) {
+		readers[i].task = kthread_run(rcuperf_reader, &readers[i],
+					      "rcuperf_reader");
+		if (IS_ERR(readers[i].task)) {
+			readers[i].task = NULL;
+			printk(KERN_ALERT PERF_FLAG "cannot start reader\n");
+		}
+	}
+
+	for (phase = 0; phase < RCUPERF_NR_PHASES; phase++)
+		if (rcuperf_run_phase(phase, base_ns))
+			break;
+
+	for (i = 0; i < nreaders; i++)
+		rcuperf_stop_threads(&readers[i].task);
+
+	p = rcu_dereference_protected(rcuperf_ptr, 1);
+	rcu_assign_pointer(rcuperf_ptr, NULL);
+	synchronize_rcu();
+	kfree(p);
+
+	printk(KERN_ALERT PERF_FLAG "end: %s\n",
+	       phase == RCUPERF_NR_PHASES ? "SUCCESS" : "STOPPED");
+
+	/* Wait for rmmod. */
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(HZ);
+	return 0;
+}
+
+static void rcuperf_cleanup(void)
+{
+	rcuperf_stop_threads(&rcuperf_task);
+	kfree(readers);
+	kfree(updaters);
+}
+
+static int __init rcuperf_init(void)
+{
+	if (nreaders < 0)
+		nreaders = num_online_cpus();
+	if (nupdaters < 0)
+		nupdaters = 0;
+	if (duration < 1)
+		duration = 1;
+	if (gp_interval_us < 1)
+		gp_interval_us = 1;
+	if (max_outstanding < 1)
+		max_outstanding = 1;
+
+	readers = kcalloc(max(nreaders, 1), sizeof(*readers), GFP_KERNEL);
+	updaters = kcalloc(max(nupdaters, 1), sizeof(*updaters), GFP_KERNEL);
+	if (!readers || !updaters)
+		goto nomem;
+
+	rcuperf_task = kthread_run(rcuperf_main, NULL, "rcuperf");
+	if (IS_ERR(rcuperf_task)) {
+		rcuperf_task = NULL;
+		rcuperf_cleanup();
+		return -ENOMEM;
+	}
+	return 0;
+
+nomem:
+	rcuperf_cleanup();
+	return -ENOMEM;
+}
+
+module_init(rcuperf_init);
+module_exit(rcuperf_cleanup);
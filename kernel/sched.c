@@ -236,6 +236,19 @@ static void destroy_rt_bandwidth(struct rt_bandwidth *rt_b)
  */
 static DEFINE_MUTEX(sched_domains_mutex);
 
+#ifdef CONFIG_SMP
+/*
+ * Wakeup placement hints of a task group, see select_task_rq_hint().
+ * Without CONFIG_CGROUP_SCHED every task has TG_WAKE_HINT_NONE.
+ */
+enum {
+	TG_WAKE_HINT_NONE,
+	TG_WAKE_HINT_FOREGROUND,
+	TG_WAKE_HINT_BACKGROUND,
+	TG_WAKE_HINT_MAX,
+};
+#endif
+
 #ifdef CONFIG_CGROUP_SCHED
 
 #include <linux/cgroup.h>
@@ -260,6 +273,28 @@ struct cfs_bandwidth {
 };
 
 /* task group related information */
+#ifdef CONFIG_SMP
+/* Per-cpu wakeup placement counters of a task group */
+struct tg_wake_stats {
+	u64 wakeups;		/* wakeups of tasks of the group */
+	u64 migrations;		/* ... placed on another cpu than last time */
+	u64 to_idle;		/* ... placed on an idle cpu */
+};
+#endif
+
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Per-cpu wakeup-to-run latency histogram of a task group.  Bucket 0 counts
+ * latencies below 1024ns, bucket i those in [2^(9+i), 2^(10+i)) ns and the
+ * last bucket everything longer.
+ */
+#define TG_LATENCY_BUCKETS	22
+
+struct tg_latency_hist {
+	u64 bucket[TG_LATENCY_BUCKETS];
+};
+#endif
+
 struct task_group {
 	struct cgroup_subsys_state css;
 
@@ -294,6 +329,16 @@ struct task_group {
 #endif
 
 	struct cfs_bandwidth cfs_bandwidth;
+
+#ifdef CONFIG_SMP
+	unsigned int wake_hint;
+#ifdef CONFIG_SCHEDSTATS
+	struct tg_wake_stats __percpu *wake_stats;
+#endif
+#endif
+#ifdef CONFIG_SCHEDSTATS
+	struct tg_latency_hist __percpu *latency_hist;
+#endif
 };
 
 /* task_group_lock serializes the addition/removal of task groups */
@@ -322,6 +367,13 @@ static int root_task_group_load = ROOT_TASK_GROUP_LOAD;
  */
 struct task_group root_task_group;
 
+#ifdef CONFIG_SCHEDSTATS
+#ifdef CONFIG_SMP
+static DEFINE_PER_CPU(struct tg_wake_stats, root_tg_wake_stats);
+#endif
+static DEFINE_PER_CPU(struct tg_latency_hist, root_tg_latency_hist);
+#endif
+
 #endif	/* CONFIG_CGROUP_SCHED */
 
 /* CFS-related fields in a runqueue */
@@ -594,6 +646,15 @@ struct rq {
 	unsigned int ave_nr_running;
 	seqcount_t ave_seqcnt;
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	/* windowed busy time for cpufreq governors */
+	u64 freq_window_start;
+	u64 freq_last_update;
+	u64 freq_curr_busy;
+	u64 freq_prev_busy;
+	unsigned int freq_alert_load;
+#endif
+
 	/* capture load from *all* tasks on this cpu: */
 	struct load_weight load;
 	unsigned long nr_load_updates;
@@ -771,6 +832,35 @@ static inline struct task_group *task_group(struct task_struct *p)
 
 #endif /* CONFIG_CGROUP_SCHED */
 
+#if defined(CONFIG_CGROUP_SCHED) && defined(CONFIG_SCHEDSTATS)
+/* Stamp a task that was just woken up and put on @rq. */
+static inline void tg_latency_wakeup(struct rq *rq, struct task_struct *p)
+{
+	p->se.statistics.wakeup_start = rq->clock;
+}
+
+/* Account the wakeup-to-run latency of @p, just picked to run on @rq. */
+static inline void tg_latency_pick(struct rq *rq, struct task_struct *p)
+{
+	u64 start = p->se.statistics.wakeup_start;
+	s64 delta;
+	int bucket;
+
+	if (!start)
+		return;
+	p->se.statistics.wakeup_start = 0;
+
+	delta = rq->clock - start;
+	if (delta < 0)
+		delta = 0;
+	bucket = min_t(int, fls64((u64)delta >> 10), TG_LATENCY_BUCKETS - 1);
+	__this_cpu_inc(task_group(p)->latency_hist->bucket[bucket]);
+}
+#else
+static inline void tg_latency_wakeup(struct rq *rq, struct task_struct *p) { }
+static inline void tg_latency_pick(struct rq *rq, struct task_struct *p) { }
+#endif
+
 static void update_rq_clock_task(struct rq *rq, s64 delta);
 
 static void update_rq_clock(struct rq *rq)
@@ -785,6 +875,259 @@ static void update_rq_clock(struct rq *rq)
 	update_rq_clock_task(rq, delta);
 }
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * Busy time for cpufreq governors, kept in windows of
+ * sysctl_sched_freq_window_us: rq->freq_curr_busy is the time a task other
+ * than idle ran in the current window, rq->freq_prev_busy the same for the
+ * window before.  Updated on every context switch and tick, so bursts
+ * shorter than a governor sample are not lost.  When the load moves by
+ * sysctl_sched_freq_alert_pct or more, the tick calls the sched load
+ * notifiers, with the load and the cpu, for the governor to re-evaluate
+ * the speed right away instead of at its next sample.
+ */
+unsigned int sysctl_sched_freq_window_us = 20000;
+unsigned int sysctl_sched_freq_alert_pct = 20;
+
+static ATOMIC_NOTIFIER_HEAD(sched_load_notifier_head);
+
+int register_sched_load_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&sched_load_notifier_head, nb);
+}
+EXPORT_SYMBOL_GPL(register_sched_load_notifier);
+
+int unregister_sched_load_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&sched_load_notifier_head, nb);
+}
+EXPORT_SYMBOL_GPL(unregister_sched_load_notifier);
+
+/*
+ * Per-task demand: the share of each window of sysctl_sched_freq_window_us
+ * a task ran for, averaged over the windows with a weight of 1/2 for the
+ * latest.  Windows the task slept through count as 0.  A heavy task that
+ * migrates takes its demand along, so the governor of the CPU it lands on
+ * need not learn it again from that CPU's own history.
+ */
+unsigned int sysctl_sched_freq_migrate_pct = 50;
+
+static ATOMIC_NOTIFIER_HEAD(sched_migration_notifier_head);
+
+int register_sched_migration_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&sched_migration_notifier_head,
+					      nb);
+}
+EXPORT_SYMBOL_GPL(register_sched_migration_notifier);
+
+int unregister_sched_migration_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&sched_migration_notifier_head,
+						nb);
+}
+EXPORT_SYMBOL_GPL(unregister_sched_migration_notifier);
+
+/*
+ * Migrations are noted under the rq locks and reported to the notifiers
+ * once the locks are dropped, from sched_migration_flush().
+ */
+static DEFINE_PER_CPU(struct sched_migration_note, sched_migration_pending);
+
+/* Bring @p's demand up to @now; @running says whether it ran since its mark. */
+static void task_demand_update(struct task_struct *p, u64 now, int running)
+{
+	u64 window = (u64)sysctl_sched_freq_window_us * NSEC_PER_USEC;
+	u64 start = p->demand_window_start;
+	u64 end = start + window;
+	u64 mark = max(p->demand_mark, start);
+	unsigned int pct, shift;
+	u64 nr;
+
+	/* rq clocks of different cpus are not in step */
+	if ((s64)(now - p->demand_mark) <= 0) {
+		p->demand_mark = now;
+		return;
+	}
+
+	if (now < end) {
+		if (running)
+			p->demand_busy += now - mark;
+		p->demand_mark = now;
+		return;
+	}
+
+	if (running && end > mark)
+		p->demand_busy += end - mark;
+	pct = min_t(u64, div64_u64(p->demand_busy * 100, window), 100);
+	p->demand = (p->demand + pct) / 2;
+
+	/* windows that went by without an update, 8 are enough to settle */
+	nr = div64_u64(now - end, window);
+	if (nr) {
+		shift = min_t(u64, nr, 8);
+		if (running)
+			p->demand = 100 - ((100 - p->demand) >> shift);
+		else
+			p->demand >>= shift;
+	}
+
+	p->demand_window_start = end + nr * window;
+	p->demand_busy = running ? now - p->demand_window_start : 0;
+	p->demand_mark = now;
+}
+
+/* Account the time since the last update to rq->curr, called under rq->lock. */
+static void freq_window_update(struct rq *rq)
+{
+	u64 window = (u64)sysctl_sched_freq_window_us * NSEC_PER_USEC;
+	u64 now = rq->clock;
+	u64 end = rq->freq_window_start + window;
+	int busy = rq->curr != rq->idle;
+	u64 nr;
+
+	if ((s64)(now - rq->freq_last_update) <= 0)
+		return;
+
+	if (now < end) {
+		if (busy)
+			rq->freq_curr_busy += now - rq->freq_last_update;
+	} else {
+		if (busy && end > rq->freq_last_update)
+			rq->freq_curr_busy += end - rq->freq_last_update;
+
+		/* windows that went by without an update */
+		nr = div64_u64(now - end, window);
+		if (nr)
+			rq->freq_prev_busy = busy ? window : 0;
+		else
+			rq->freq_prev_busy = rq->freq_curr_busy;
+		rq->freq_window_start = end + nr * window;
+		rq->freq_curr_busy = busy ? now - rq->freq_window_start : 0;
+	}
+	rq->freq_last_update = now;
+}
+
+/*
+ * Busy percentage over the last window's worth of time, taking the part
+ * of the previous window the current one has not yet replaced.
+ */
+static unsigned int freq_window_load(struct rq *rq)
+{
+	u64 window = (u64)sysctl_sched_freq_window_us * NSEC_PER_USEC;
+	u64 elapsed = rq->clock - rq->freq_window_start;
+	u64 busy = rq->freq_curr_busy;
+
+	if (elapsed < window)
+		busy += div64_u64(rq->freq_prev_busy * (window - elapsed),
+				  window);
+	return min_t(u64, div64_u64(busy * 100, window), 100);
+}
+
+/* Returns the load to report to the notifiers, or -1 if it changed little. */
+static int freq_window_tick(struct rq *rq)
+{
+	unsigned int load;
+
+	freq_window_update(rq);
+	if (rq->curr != rq->idle)
+		task_demand_update(rq->curr, rq->clock, 1);
+	load = freq_window_load(rq);
+	if (abs((int)load - (int)rq->freq_alert_load) <
+	    sysctl_sched_freq_alert_pct)
+		return -1;
+	rq->freq_alert_load = load;
+	return load;
+}
+
+static void freq_window_alert(int cpu, int load)
+{
+	if (load >= 0)
+		atomic_notifier_call_chain(&sched_load_notifier_head, load,
+					   (void *)(long)cpu);
+}
+
+/**
+ * sched_get_cpu_load - busy percentage of @cpu over the last window
+ * @cpu: the cpu to look at
+ *
+ * See sysctl_sched_freq_window_us for the length of the window.
+ */
+unsigned int sched_get_cpu_load(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+	unsigned int load;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	update_rq_clock(rq);
+	freq_window_update(rq);
+	load = freq_window_load(rq);
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	return load;
+}
+EXPORT_SYMBOL_GPL(sched_get_cpu_load);
+
+static void freq_window_switch(struct rq *rq, struct task_struct *prev,
+			       struct task_struct *next)
+{
+	freq_window_update(rq);
+	if (prev != rq->idle)
+		task_demand_update(prev, rq->clock, 1);
+	if (next != rq->idle)
+		task_demand_update(next, rq->clock, 0);
+}
+
+/* Called from set_task_cpu() with the rq or pi lock held. */
+static void freq_migrate_note(struct task_struct *p, int src_cpu,
+			      int dest_cpu)
+{
+	struct sched_migration_note *note;
+
+	/* decay the demand of a task that slept since it last ran */
+	task_demand_update(p, cpu_rq(src_cpu)->clock, 0);
+	if (!p->demand || p->demand < sysctl_sched_freq_migrate_pct)
+		return;
+
+	note = &__get_cpu_var(sched_migration_pending);
+	if (p->demand > note->demand) {
+		note->src_cpu = src_cpu;
+		note->dest_cpu = dest_cpu;
+		note->demand = p->demand;
+	}
+}
+
+/* Report the migration noted on this cpu, if any.  No rq lock may be held. */
+static void sched_migration_flush(void)
+{
+	struct sched_migration_note *pending, note;
+	unsigned long flags;
+
+	if (likely(!__this_cpu_read(sched_migration_pending.demand)))
+		return;
+
+	local_irq_save(flags);
+	pending = &__get_cpu_var(sched_migration_pending);
+	note = *pending;
+	pending->demand = 0;
+	local_irq_restore(flags);
+
+	if (note.demand)
+		atomic_notifier_call_chain(&sched_migration_notifier_head, 0,
+					   &note);
+}
+#else
+static inline void freq_window_update(struct rq *rq) { }
+static inline int freq_window_tick(struct rq *rq) { return -1; }
+static inline void freq_window_alert(int cpu, int load) { }
+static inline void freq_window_switch(struct rq *rq, struct task_struct *prev,
+				      struct task_struct *next) { }
+static inline void freq_migrate_note(struct task_struct *p, int src_cpu,
+				     int dest_cpu) { }
+static inline void sched_migration_flush(void) { }
+#endif
+
 /*
  * Tunables that become constants when CONFIG_SCHED_DEBUG is off:
  */
@@ -2381,6 +2724,7 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 			p->sched_class->migrate_task_rq(p, new_cpu);
 		p->se.nr_migrations++;
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, 1, NULL, 0);
+		freq_migrate_note(p, task_cpu(p), new_cpu);
 	}
 
 	__set_task_cpu(p, new_cpu);
@@ -2667,6 +3011,7 @@ static void ttwu_activate(struct rq *rq, struct task_struct *p, int en_flags)
 {
 	activate_task(rq, p, en_flags);
 	p->on_rq = 1;
+	tg_latency_wakeup(rq, p);
 
 	/* if a worker is waking up, notify workqueue */
 	if (p->flags & PF_WQ_WORKER)
@@ -2900,6 +3245,7 @@ stat:
 	ttwu_stat(p, cpu, wake_flags);
 out:
 	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
+	sched_migration_flush();
 
 	return success;
 }
@@ -2990,6 +3336,13 @@ static void __sched_fork(struct task_struct *p)
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	p->demand_window_start = 0;
+	p->demand_mark = 0;
+	p->demand_busy = 0;
+	p->demand = 0;
+#endif
+
 	INIT_LIST_HEAD(&p->rt.run_list);
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
@@ -3124,6 +3477,7 @@ void wake_up_new_task(struct task_struct *p)
 		p->sched_class->task_woken(rq, p);
 #endif
 	task_rq_unlock(rq, p, &flags);
+	sched_migration_flush();
 }
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
@@ -4393,15 +4747,19 @@ void scheduler_tick(void)
 	int cpu = smp_processor_id();
 	struct rq *rq = cpu_rq(cpu);
 	struct task_struct *curr = rq->curr;
+	int freq_load;
 
 	sched_clock_tick();
 
 	raw_spin_lock(&rq->lock);
 	update_rq_clock(rq);
 	update_cpu_load_active(rq);
+	freq_load = freq_window_tick(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
 	raw_spin_unlock(&rq->lock);
 
+	freq_window_alert(cpu, freq_load);
+
 	perf_event_task_tick();
 
 #ifdef CONFIG_SMP
@@ -4600,10 +4958,12 @@ need_resched:
 
 	put_prev_task(rq, prev);
 	next = pick_next_task(rq);
+	tg_latency_pick(rq, next);
 	clear_tsk_need_resched(prev);
 	rq->skip_clock_update = 0;
 
 	if (likely(prev != next)) {
+		freq_window_switch(rq, prev, next);
 		rq->nr_switches++;
 		rq->curr = next;
 #ifdef CONFIG_PREEMPT_COUNT_CPU
@@ -4624,6 +4984,7 @@ need_resched:
 		raw_spin_unlock_irq(&rq->lock);
 
 	post_schedule(rq);
+	sched_migration_flush();
 
 	preempt_enable_no_resched();
 	if (need_resched())
@@ -6508,6 +6869,7 @@ static int migration_cpu_stop(void *data)
 	local_irq_disable();
 	__migrate_task(arg->task, raw_smp_processor_id(), arg->dest_cpu);
 	local_irq_enable();
+	sched_migration_flush();
 	return 0;
 }
 
@@ -8476,6 +8838,12 @@ void __init sched_init(void)
 	list_add(&root_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&root_task_group.children);
 	autogroup_init(&init_task);
+#ifdef CONFIG_SCHEDSTATS
+#ifdef CONFIG_SMP
+	root_task_group.wake_stats = &root_tg_wake_stats;
+#endif
+	root_task_group.latency_hist = &root_tg_latency_hist;
+#endif
 #endif /* CONFIG_CGROUP_SCHED */
 
 	for_each_possible_cpu(i) {
@@ -8927,10 +9295,39 @@ int alloc_rt_sched_group(struct task_group *tg, struct task_group *parent)
 #endif /* CONFIG_RT_GROUP_SCHED */
 
 #ifdef CONFIG_CGROUP_SCHED
+#ifdef CONFIG_SCHEDSTATS
+static int alloc_tg_sched_stats(struct task_group *tg)
+{
+#ifdef CONFIG_SMP
+	tg->wake_stats = alloc_percpu(struct tg_wake_stats);
+	if (!tg->wake_stats)
+		return 0;
+#endif
+	tg->latency_hist = alloc_percpu(struct tg_latency_hist);
+	return tg->latency_hist != NULL;
+}
+
+static void free_tg_sched_stats(struct task_group *tg)
+{
+#ifdef CONFIG_SMP
+	free_percpu(tg->wake_stats);
+#endif
+	free_percpu(tg->latency_hist);
+}
+#else
+static inline int alloc_tg_sched_stats(struct task_group *tg)
+{
+	return 1;
+}
+
+static inline void free_tg_sched_stats(struct task_group *tg) { }
+#endif
+
 static void free_sched_group(struct task_group *tg)
 {
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
+	free_tg_sched_stats(tg);
 	autogroup_free(tg);
 	kfree(tg);
 }
@@ -8951,6 +9348,9 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+	if (!alloc_tg_sched_stats(tg))
+		goto err;
+
 	spin_lock_irqsave(&task_group_lock, flags);
 	list_add_rcu(&tg->list, &task_groups);
 
@@ -9704,6 +10104,80 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_SMP
+static u64 cpu_wake_hint_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->wake_hint;
+}
+
+static int cpu_wake_hint_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				   u64 hint)
+{
+	if (hint >= TG_WAKE_HINT_MAX)
+		return -EINVAL;
+
+	cgroup_tg(cgrp)->wake_hint = hint;
+	return 0;
+}
+
+#ifdef CONFIG_SCHEDSTATS
+static int cpu_wake_stats_read_map(struct cgroup *cgrp, struct cftype *cft,
+				   struct cgroup_map_cb *cb)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	struct tg_wake_stats *stats, sum = { 0 };
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		stats = per_cpu_ptr(tg->wake_stats, cpu);
+		sum.wakeups += stats->wakeups;
+		sum.migrations += stats->migrations;
+		sum.to_idle += stats->to_idle;
+	}
+
+	cb->fill(cb, "wakeups", sum.wakeups);
+	cb->fill(cb, "migrations", sum.migrations);
+	cb->fill(cb, "to_idle", sum.to_idle);
+	return 0;
+}
+#endif /* CONFIG_SCHEDSTATS */
+#endif /* CONFIG_SMP */
+
+#ifdef CONFIG_SCHEDSTATS
+static int cpu_latency_hist_show(struct cgroup *cgrp, struct cftype *cft,
+				 struct seq_file *m)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	u64 count;
+	int i, cpu;
+
+	for (i = 0; i < TG_LATENCY_BUCKETS; i++) {
+		count = 0;
+		for_each_possible_cpu(cpu)
+			count += per_cpu_ptr(tg->latency_hist, cpu)->bucket[i];
+
+		if (i == TG_LATENCY_BUCKETS - 1)
+			seq_printf(m, "%llu-inf %llu\n", 1ULL << (9 + i), count);
+		else
+			seq_printf(m, "%llu-%llu %llu\n",
+				   i ? 1ULL << (9 + i) : 0ULL,
+				   1ULL << (10 + i), count);
+	}
+	return 0;
+}
+
+static int cpu_latency_hist_reset(struct cgroup *cgrp, unsigned int event)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(tg->latency_hist, cpu), 0,
+		       sizeof(struct tg_latency_hist));
+	return 0;
+}
+#endif /* CONFIG_SCHEDSTATS */
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -9712,6 +10186,26 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_shares_write_u64,
 	},
 #endif
+#ifdef CONFIG_SMP
+	{
+		.name = "wake_hint",
+		.read_u64 = cpu_wake_hint_read_u64,
+		.write_u64 = cpu_wake_hint_write_u64,
+	},
+#ifdef CONFIG_SCHEDSTATS
+	{
+		.name = "wake_stats",
+		.read_map = cpu_wake_stats_read_map,
+	},
+#endif
+#endif
+#ifdef CONFIG_SCHEDSTATS
+	{
+		.name = "latency_hist",
+		.read_seq_string = cpu_latency_hist_show,
+		.trigger = cpu_latency_hist_reset,
+	},
+#endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
 		.name = "cfs_quota_us",
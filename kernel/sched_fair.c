@@ -2773,7 +2773,7 @@ static int check_pack_buddy(int cpu, struct task_struct *p)
  * preempt must be disabled.
  */
 static int
-select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
+__select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 {
 	struct sched_domain *tmp, *affine_sd = NULL, *sd = NULL;
 	int cpu = smp_processor_id();
@@ -2893,6 +2893,114 @@ unlock:
 	return new_cpu;
 }
 
+#ifdef CONFIG_CGROUP_SCHED
+static inline unsigned int task_wake_hint(struct task_struct *p)
+{
+	return task_group(p)->wake_hint;
+}
+#else
+static inline unsigned int task_wake_hint(struct task_struct *p)
+{
+	return TG_WAKE_HINT_NONE;
+}
+#endif
+
+static inline bool cpu_runs_foreground(int cpu)
+{
+	return task_wake_hint(cpu_curr(cpu)) == TG_WAKE_HINT_FOREGROUND;
+}
+
+static inline bool wake_hint_cpu_ok(struct task_struct *p, int cpu)
+{
+	return cpumask_test_cpu(cpu, tsk_cpus_allowed(p)) &&
+		cpu_active(cpu);
+}
+
+/*
+ * Wakeup placement for task groups tagged through the cpu controller's
+ * wake_hint file.  A foreground task goes to an idle cpu, or failing that
+ * to the least loaded one, so that it does not queue behind other work.
+ * A background task is packed onto a cpu that is already busy with
+ * something other than foreground work, so that it neither wakes an idle
+ * cpu nor lands next to the UI.
+ *
+ * Returns -1 when the group has no hint or no cpu fits, in which case the
+ * normal balancing applies.
+ */
+static int select_task_rq_hint(struct task_struct *p, int prev_cpu)
+{
+	unsigned long load, min_load = ULONG_MAX;
+	int i, best = -1;
+
+	switch (task_wake_hint(p)) {
+	case TG_WAKE_HINT_FOREGROUND:
+		if (idle_cpu(prev_cpu) && wake_hint_cpu_ok(p, prev_cpu))
+			return prev_cpu;
+		for_each_cpu_and(i, cpu_active_mask, tsk_cpus_allowed(p)) {
+			if (idle_cpu(i))
+				return i;
+			load = weighted_cpuload(i);
+			if (load < min_load) {
+				min_load = load;
+				best = i;
+			}
+		}
+		break;
+
+	case TG_WAKE_HINT_BACKGROUND:
+		rcu_read_lock();
+		if (!idle_cpu(prev_cpu) && wake_hint_cpu_ok(p, prev_cpu) &&
+		    !cpu_runs_foreground(prev_cpu)) {
+			best = prev_cpu;
+		} else {
+			for_each_cpu_and(i, cpu_active_mask,
+					 tsk_cpus_allowed(p)) {
+				if (!idle_cpu(i) && !cpu_runs_foreground(i)) {
+					best = i;
+					break;
+				}
+			}
+		}
+		rcu_read_unlock();
+		break;
+	}
+
+	return best;
+}
+
+#if defined(CONFIG_CGROUP_SCHED) && defined(CONFIG_SCHEDSTATS)
+static void tg_wake_account(struct task_struct *p, int prev_cpu, int new_cpu)
+{
+	struct tg_wake_stats *stats;
+
+	stats = this_cpu_ptr(task_group(p)->wake_stats);
+	stats->wakeups++;
+	if (new_cpu != prev_cpu)
+		stats->migrations++;
+	if (idle_cpu(new_cpu))
+		stats->to_idle++;
+}
+#else
+static inline void
+tg_wake_account(struct task_struct *p, int prev_cpu, int new_cpu) { }
+#endif
+
+static int
+select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
+{
+	int prev_cpu = task_cpu(p);
+	int new_cpu = -1;
+
+	if (sd_flag & SD_BALANCE_WAKE)
+		new_cpu = select_task_rq_hint(p, prev_cpu);
+	if (new_cpu < 0)
+		new_cpu = __select_task_rq_fair(p, sd_flag, wake_flags);
+	if (sd_flag & SD_BALANCE_WAKE)
+		tg_wake_account(p, prev_cpu, new_cpu);
+
+	return new_cpu;
+}
+
 /*
  * Called immediately before a task is migrated to a new cpu; task_cpu(p) and
  * cfs_rq_of(p) references at time of call are still valid and identify the
@@ -4782,6 +4890,7 @@ static int active_load_balance_cpu_stop(void *data)
 out_unlock:
 	busiest_rq->active_balance = 0;
 	raw_spin_unlock_irq(&busiest_rq->lock);
+	sched_migration_flush();
 	return 0;
 }
 
@@ -5265,6 +5374,7 @@ static void run_rebalance_domains(struct softirq_action *h)
 	 * stopped.
 	 */
 	nohz_idle_balance(this_cpu, idle);
+	sched_migration_flush();
 }
 
 static inline int on_null_domain(int cpu)
@@ -271,6 +271,11 @@ static int min_sched_tunable_scaling = SCHED_TUNABLESCALING_NONE;
 static int max_sched_tunable_scaling = SCHED_TUNABLESCALING_END-1;
 #endif
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+static int min_sched_freq_window_us = 1000;		/* 1 msec */
+static int max_sched_freq_window_us = USEC_PER_SEC;	/* 1 second */
+#endif
+
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
@@ -394,6 +399,35 @@ static struct ctl_table kern_table[] = {
                 .extra1         = &one,
         },
 #endif
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	{
+		.procname	= "sched_freq_window_us",
+		.data		= &sysctl_sched_freq_window_us,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &min_sched_freq_window_us,
+		.extra2		= &max_sched_freq_window_us,
+	},
+	{
+		.procname	= "sched_freq_alert_pct",
+		.data		= &sysctl_sched_freq_alert_pct,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+		.extra2		= &one_hundred,
+	},
+	{
+		.procname	= "sched_freq_migrate_pct",
+		.data		= &sysctl_sched_freq_migrate_pct,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one_hundred,
+	},
+#endif
 #ifdef CONFIG_PROVE_LOCKING
 	{
 		.procname	= "prove_locking",
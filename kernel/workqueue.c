@@ -41,6 +41,9 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/hash.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_sched.h"
 
@@ -454,6 +457,189 @@ static inline void debug_work_activate(struct work_struct *work) { }
 static inline void debug_work_deactivate(struct work_struct *work) { }
 #endif
 
+#ifdef CONFIG_WQ_FUNC_STATS
+
+/*
+ * Per work function execution statistics, aggregated in a small open
+ * addressed hash table keyed by the function pointer.  Functions that
+ * don't fit once the table is full are only counted as dropped.
+ */
+#define WQ_FUNC_STATS_BITS	9
+#define WQ_FUNC_STATS_SIZE	(1 << WQ_FUNC_STATS_BITS)
+
+struct wq_func_stat {
+	work_func_t		func;
+	unsigned long		count;
+	u64			total_ns;	/* time spent in func */
+	u64			max_ns;
+	u64			lat_total_ns;	/* time from queueing to start */
+	u64			lat_max_ns;
+};
+
+static struct wq_func_stat wq_func_stats[WQ_FUNC_STATS_SIZE];
+static unsigned long wq_func_stats_dropped;
+static DEFINE_SPINLOCK(wq_func_stats_lock);
+
+static u32 wq_func_stats_enabled = 1;	/* aggregate into wq_func_stats */
+static u32 wq_slow_work_ms;		/* trace works running this long */
+
+static inline bool wq_stats_active(void)
+{
+	return wq_func_stats_enabled || wq_slow_work_ms;
+}
+
+static inline void wq_stats_queued(struct work_struct *work)
+{
+	work->queued_at = wq_stats_active() ? local_clock() : 0;
+}
+
+static inline u64 wq_stats_queued_at(struct work_struct *work)
+{
+	return work->queued_at;
+}
+
+static inline u64 wq_stats_start(void)
+{
+	return wq_stats_active() ? local_clock() : 0;
+}
+
+static struct wq_func_stat *wq_func_stat_find(work_func_t func)
+{
+	unsigned long i, h = hash_ptr(func, WQ_FUNC_STATS_BITS);
+
+	for (i = 0; i < WQ_FUNC_STATS_SIZE; i++) {
+		struct wq_func_stat *st;
+
+		st = &wq_func_stats[(h + i) & (WQ_FUNC_STATS_SIZE - 1)];
+		if (st->func == func)
+			return st;
+		if (!st->func) {
+			st->func = func;
+			return st;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * wq_stats_account - account one execution of a work function
+ * @func: the work function that ran
+ * @queued_at: local_clock() when the work was queued, 0 if unknown
+ * @start: wq_stats_start() before @func was called
+ *
+ * CONTEXT:
+ * Worker thread, no locks held.
+ */
+static void wq_stats_account(work_func_t func, u64 queued_at, u64 start)
+{
+	struct wq_func_stat *st;
+	u64 runtime, latency = 0;
+
+	if (!start)
+		return;
+	runtime = local_clock() - start;
+	if (queued_at && (s64)(start - queued_at) > 0)
+		latency = start - queued_at;
+
+	if (wq_slow_work_ms && runtime >= (u64)wq_slow_work_ms * NSEC_PER_MSEC)
+		trace_workqueue_slow_work(func, runtime, latency);
+
+	if (!wq_func_stats_enabled)
+		return;
+
+	spin_lock(&wq_func_stats_lock);
+	st = wq_func_stat_find(func);
+	if (st) {
+		st->count++;
+		st->total_ns += runtime;
+		if (runtime > st->max_ns)
+			st->max_ns = runtime;
+		st->lat_total_ns += latency;
+		if (latency > st->lat_max_ns)
+			st->lat_max_ns = latency;
+	} else {
+		wq_func_stats_dropped++;
+	}
+	spin_unlock(&wq_func_stats_lock);
+}
+
+static int wq_func_stats_show(struct seq_file *m, void *unused)
+{
+	struct wq_func_stat st;
+	int i;
+
+	seq_printf(m, "%-40s %10s %12s %10s %10s %10s %10s\n",
+		   "function", "count", "total_us", "avg_us", "max_us",
+		   "lat_avg_us", "lat_max_us");
+
+	for (i = 0; i < WQ_FUNC_STATS_SIZE; i++) {
+		spin_lock(&wq_func_stats_lock);
+		st = wq_func_stats[i];
+		spin_unlock(&wq_func_stats_lock);
+
+		if (!st.func || !st.count)
+			continue;
+		seq_printf(m, "%-40pf %10lu %12llu %10llu %10llu %10llu %10llu\n",
+			   st.func, st.count,
+			   div_u64(st.total_ns, NSEC_PER_USEC),
+			   div_u64(div_u64(st.total_ns, st.count), NSEC_PER_USEC),
+			   div_u64(st.max_ns, NSEC_PER_USEC),
+			   div_u64(div_u64(st.lat_total_ns, st.count),
+				   NSEC_PER_USEC),
+			   div_u64(st.lat_max_ns, NSEC_PER_USEC));
+	}
+	if (wq_func_stats_dropped)
+		seq_printf(m, "dropped: %lu\n", wq_func_stats_dropped);
+	return 0;
+}
+
+static int wq_func_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_func_stats_show, NULL);
+}
+
+/* Any write resets the statistics. */
+static ssize_t wq_func_stats_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	spin_lock(&wq_func_stats_lock);
+	memset(wq_func_stats, 0, sizeof(wq_func_stats));
+	wq_func_stats_dropped = 0;
+	spin_unlock(&wq_func_stats_lock);
+	return count;
+}
+
+static const struct file_operations wq_func_stats_fops = {
+	.open		= wq_func_stats_open,
+	.read		= seq_read,
+	.write		= wq_func_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_func_stats_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("workqueue", NULL);
+	if (!dir)
+		return -ENOMEM;
+	debugfs_create_file("func_stats", 0644, dir, NULL, &wq_func_stats_fops);
+	debugfs_create_bool("func_stats_enable", 0644, dir,
+			    &wq_func_stats_enabled);
+	debugfs_create_u32("slow_work_ms", 0644, dir, &wq_slow_work_ms);
+	return 0;
+}
+late_initcall(wq_func_stats_init);
+
+#else
+static inline void wq_stats_queued(struct work_struct *work) { }
+static inline u64 wq_stats_queued_at(struct work_struct *work) { return 0; }
+static inline u64 wq_stats_start(void) { return 0; }
+static inline void wq_stats_account(work_func_t func, u64 queued_at,
+				    u64 start) { }
+#endif
+
 /* Serializes the accesses to the list of workqueues. */
 static DEFINE_SPINLOCK(workqueue_lock);
 static LIST_HEAD(workqueues);
@@ -950,6 +1136,7 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 
 	/* we own @work, set data and link */
 	set_work_cwq(work, cwq, extra_flags);
+	wq_stats_queued(work);
 
 	/*
 	 * Ensure that we get the right work->data if we see the
@@ -1836,6 +2023,7 @@ __acquires(&gcwq->lock)
 	work_func_t f = work->func;
 	int work_color;
 	struct worker *collision;
+	u64 queued_at, start;
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -1870,6 +2058,7 @@ __acquires(&gcwq->lock)
 	/* record the current cpu number in the work data and dequeue */
 	set_work_cpu(work, gcwq->cpu);
 	list_del_init(&work->entry);
+	queued_at = wq_stats_queued_at(work);
 
 	/*
 	 * If HIGHPRI_PENDING, check the next work, and, if HIGHPRI,
@@ -1901,12 +2090,14 @@ __acquires(&gcwq->lock)
 	lock_map_acquire_read(&cwq->wq->lockdep_map);
 	lock_map_acquire(&lockdep_map);
 	trace_workqueue_execute_start(work);
+	start = wq_stats_start();
 	f(work);
 	/*
 	 * While we must be careful to not use "work" after this, the trace
 	 * point will only record its address.
 	 */
 	trace_workqueue_execute_end(work);
+	wq_stats_account(f, queued_at, start);
 	lock_map_release(&lockdep_map);
 	lock_map_release(&cwq->wq->lockdep_map);
 
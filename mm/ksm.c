@@ -23,7 +23,6 @@
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
 #include <linux/spinlock.h>
-#include <linux/jhash.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
@@ -33,9 +32,14 @@
 #include <linux/mmu_notifier.h>
 #include <linux/swap.h>
 #include <linux/ksm.h>
+#include <linux/ksm_hash.h>
 #include <linux/hash.h>
 #include <linux/freezer.h>
 #include <linux/oom.h>
+#include <linux/vmpressure.h>
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -192,6 +196,57 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 /* Boolean to indicate whether to use deferred timer or not */
 static bool use_deferred_timer;
 
+/*
+ * The checksum only tells ksmd whether a page changed since the last pass,
+ * so by default just a sample of it is hashed: ksm_checksum_blocks blocks of
+ * KSM_CHECKSUM_BLOCK bytes, spread evenly across the page.  A change outside
+ * the sample lets a volatile page into the unstable tree, where the full
+ * memcmp_pages() of the tree walk and of try_to_merge_one_page() still
+ * decides every merge.  0 hashes the whole page.
+ */
+#define KSM_CHECKSUM_BLOCK	64
+#define KSM_CHECKSUM_MAX_BLOCKS	(PAGE_SIZE / KSM_CHECKSUM_BLOCK)
+static unsigned int ksm_checksum_blocks = 8;
+
+/*
+ * Per full-scan statistics.  ksm_pass_cur accumulates while ksmd walks the
+ * mm list and is copied to ksm_pass_last each time it wraps round.
+ */
+struct ksm_pass_stats {
+	unsigned long pages_scanned;	/* rmap_items visited */
+	unsigned long pages_hashed;	/* calc_checksum() calls */
+	unsigned long pages_merged;	/* rmap_items added to the stable tree */
+	u64 cpu_ns;			/* ksmd cpu time spent scanning */
+};
+static struct ksm_pass_stats ksm_pass_cur;
+static struct ksm_pass_stats ksm_pass_last;
+static u64 ksm_pass_runtime;
+
+/*
+ * Adaptive scanning.  At the end of every full scan ksmd looks at the merge
+ * yield of the pass (pages merged per thousand scanned): a good yield
+ * doubles pages_to_scan, up to KSM_ADAPT_MAX_BOOST doublings, and a poor one
+ * undoes the boost and then doubles sleep_millisecs, up to
+ * KSM_ADAPT_MAX_BACKOFF doublings.  Medium or worse vmpressure boosts ksmd
+ * fully for KSM_ADAPT_PRESSURE_HOLD, and with the screen off it stays
+ * fully backed off.  pages_to_scan and sleep_millisecs remain the base rate.
+ */
+#define KSM_ADAPT_MAX_BOOST	3
+#define KSM_ADAPT_MAX_BACKOFF	6
+#define KSM_ADAPT_YIELD_HIGH	10
+#define KSM_ADAPT_YIELD_LOW	1
+#define KSM_ADAPT_PRESSURE	60		/* vmpressure "medium" */
+#define KSM_ADAPT_PRESSURE_HOLD	HZ
+
+static bool ksm_adaptive;
+static unsigned int ksm_adapt_boost;
+static unsigned int ksm_adapt_backoff;
+static bool ksm_adapt_pressure;
+static unsigned long ksm_adapt_pressure_expires;
+static bool ksm_screen_off;
+
+static struct task_struct *ksmd_thread;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -674,12 +729,33 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+static u32 ksm_hash_sample(const void *addr, unsigned int blocks)
+{
+	unsigned int stride = (KSM_CHECKSUM_MAX_BLOCKS / blocks) *
+				KSM_CHECKSUM_BLOCK;
+	u32 checksum = 17;
+	unsigned int i;
+
+	for (i = 0; i < blocks; i++)
+		checksum = ksm_hash_words(addr + i * stride,
+				KSM_CHECKSUM_BLOCK / 4, checksum);
+	return checksum;
+}
+
 static u32 calc_checksum(struct page *page)
 {
+	unsigned int blocks = ACCESS_ONCE(ksm_checksum_blocks);
 	u32 checksum;
-	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	void *addr;
+
+	if (!blocks || blocks > KSM_CHECKSUM_MAX_BLOCKS)
+		blocks = KSM_CHECKSUM_MAX_BLOCKS;
+
+	addr = kmap_atomic(page, KM_USER0);
+	checksum = ksm_hash_sample(addr, blocks);
 	kunmap_atomic(addr, KM_USER0);
+
+	ksm_pass_cur.pages_hashed++;
 	return checksum;
 }
 
@@ -1196,6 +1272,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			ksm_pass_cur.pages_merged++;
 		}
 		put_page(kpage);
 		return;
@@ -1232,6 +1309,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			if (stable_node) {
 				stable_tree_append(tree_rmap_item, stable_node);
 				stable_tree_append(rmap_item, stable_node);
+				ksm_pass_cur.pages_merged += 2;
 			}
 			unlock_page(kpage);
 
@@ -1277,6 +1355,122 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * Charge ksmd's cpu time since the last call to the current pass.
+ */
+static void ksm_pass_account(void)
+{
+	u64 runtime = task_sched_runtime(current);
+
+	ksm_pass_cur.cpu_ns += runtime - ksm_pass_runtime;
+	ksm_pass_runtime = runtime;
+}
+
+/* merge yield of a pass, in pages merged per thousand scanned */
+static unsigned int ksm_pass_yield(struct ksm_pass_stats *stats)
+{
+	if (!stats->pages_scanned)
+		return 0;
+	return stats->pages_merged * 1000 / stats->pages_scanned;
+}
+
+static bool ksm_under_pressure(void)
+{
+	return ACCESS_ONCE(ksm_adapt_pressure) &&
+		time_before(jiffies, ACCESS_ONCE(ksm_adapt_pressure_expires));
+}
+
+static void ksm_adapt(void)
+{
+	unsigned int yield = ksm_pass_yield(&ksm_pass_last);
+
+	if (yield >= KSM_ADAPT_YIELD_HIGH) {
+		ksm_adapt_backoff = 0;
+		if (ksm_adapt_boost < KSM_ADAPT_MAX_BOOST)
+			ksm_adapt_boost++;
+	} else if (yield < KSM_ADAPT_YIELD_LOW) {
+		if (ksm_adapt_boost)
+			ksm_adapt_boost--;
+		else if (ksm_adapt_backoff < KSM_ADAPT_MAX_BACKOFF)
+			ksm_adapt_backoff++;
+	} else {
+		ksm_adapt_backoff = 0;
+	}
+}
+
+static unsigned int ksm_scan_pages(void)
+{
+	unsigned int boost = ksm_adapt_boost;
+
+	if (!ksm_adaptive || ksm_screen_off)
+		return ksm_thread_pages_to_scan;
+	if (ksm_under_pressure())
+		boost = KSM_ADAPT_MAX_BOOST;
+	return min_t(unsigned long,
+		     (unsigned long)ksm_thread_pages_to_scan << boost, UINT_MAX);
+}
+
+static unsigned int ksm_sleep_millisecs(void)
+{
+	unsigned int backoff = ksm_adapt_backoff;
+
+	if (!ksm_adaptive)
+		return ksm_thread_sleep_millisecs;
+	if (ksm_screen_off)
+		backoff = KSM_ADAPT_MAX_BACKOFF;
+	else if (ksm_under_pressure())
+		backoff = 0;
+	return min_t(unsigned long,
+		     (unsigned long)ksm_thread_sleep_millisecs << backoff,
+		     UINT_MAX);
+}
+
+static int ksm_vmpressure_notifier(struct notifier_block *nb,
+				   unsigned long action, void *data)
+{
+	if (action < KSM_ADAPT_PRESSURE)
+		return 0;
+
+	ksm_adapt_pressure_expires = jiffies + KSM_ADAPT_PRESSURE_HOLD;
+	ksm_adapt_pressure = true;
+	if (ksm_adaptive && ksmd_thread)
+		wake_up_process(ksmd_thread);
+	return 0;
+}
+
+static struct notifier_block ksm_vmpressure_nb = {
+	.notifier_call = ksm_vmpressure_notifier,
+};
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void ksm_early_suspend(struct early_suspend *h)
+{
+	ksm_screen_off = true;
+}
+
+static void ksm_late_resume(struct early_suspend *h)
+{
+	ksm_screen_off = false;
+	ksm_adapt_backoff = 0;
+	if (ksm_adaptive && ksmd_thread)
+		wake_up_process(ksmd_thread);
+}
+
+static struct early_suspend ksm_early_suspend_handler = {
+	.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN,
+	.suspend = ksm_early_suspend,
+	.resume = ksm_late_resume,
+};
+#endif
+
+static void ksm_pass_end(void)
+{
+	ksm_pass_account();
+	ksm_pass_last = ksm_pass_cur;
+	memset(&ksm_pass_cur, 0, sizeof(ksm_pass_cur));
+	ksm_adapt();
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1405,6 +1599,7 @@ next_mm:
 		goto next_mm;
 
 	ksm_scan.seqnr++;
+	ksm_pass_end();
 	return NULL;
 }
 
@@ -1442,17 +1637,20 @@ static void ksm_do_scan(unsigned int scan_npages)
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
 
+	ksm_pass_runtime = task_sched_runtime(current);
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
-			return;
+			break;
+		ksm_pass_cur.pages_scanned++;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item)) {
 			if (!is_page_scanned(page))
 				cmp_and_merge_page(page, rmap_item);
 		}
 		put_page(page);
 	}
+	ksm_pass_account();
 }
 
 static void process_timeout(unsigned long __data)
@@ -1503,7 +1701,7 @@ static int ksm_scan_thread(void *nothing)
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
 		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_do_scan(ksm_scan_pages());
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -1511,10 +1709,10 @@ static int ksm_scan_thread(void *nothing)
 		if (ksmd_should_run()) {
 			if (use_deferred_timer)
 				deferred_schedule_timeout(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				msecs_to_jiffies(ksm_sleep_millisecs()));
 			else
 				schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				msecs_to_jiffies(ksm_sleep_millisecs()));
 		} else {
 			wait_event_freezable(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -2058,6 +2256,108 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t checksum_blocks_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_checksum_blocks);
+}
+
+static ssize_t checksum_blocks_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	unsigned long blocks;
+	int err;
+
+	err = strict_strtoul(buf, 10, &blocks);
+	if (err || blocks > KSM_CHECKSUM_MAX_BLOCKS)
+		return -EINVAL;
+
+	ksm_checksum_blocks = blocks;
+
+	return count;
+}
+KSM_ATTR(checksum_blocks);
+
+static ssize_t pass_pages_scanned_show(struct kobject *kobj,
+				       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pass_last.pages_scanned);
+}
+KSM_ATTR_RO(pass_pages_scanned);
+
+static ssize_t pass_pages_hashed_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pass_last.pages_hashed);
+}
+KSM_ATTR_RO(pass_pages_hashed);
+
+static ssize_t pass_pages_merged_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pass_last.pages_merged);
+}
+KSM_ATTR_RO(pass_pages_merged);
+
+static ssize_t pass_cpu_usecs_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	u64 usecs = ksm_pass_last.cpu_ns;
+
+	do_div(usecs, NSEC_PER_USEC);
+	return sprintf(buf, "%llu\n", usecs);
+}
+KSM_ATTR_RO(pass_cpu_usecs);
+
+static ssize_t pass_merge_yield_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_pass_yield(&ksm_pass_last));
+}
+KSM_ATTR_RO(pass_merge_yield);
+
+static ssize_t adaptive_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive);
+}
+
+static ssize_t adaptive_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t count)
+{
+	unsigned long enable;
+	int err;
+
+	err = strict_strtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	ksm_adaptive = enable;
+	ksm_adapt_boost = 0;
+	ksm_adapt_backoff = 0;
+
+	return count;
+}
+KSM_ATTR(adaptive);
+
+static ssize_t current_pages_to_scan_show(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_scan_pages());
+}
+KSM_ATTR_RO(current_pages_to_scan);
+
+static ssize_t current_sleep_millisecs_show(struct kobject *kobj,
+					    struct kobj_attribute *attr,
+					    char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_sleep_millisecs());
+}
+KSM_ATTR_RO(current_sleep_millisecs);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -2068,6 +2368,15 @@ static struct attribute *ksm_attrs[] = {
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
 	&deferred_timer_attr.attr,
+	&checksum_blocks_attr.attr,
+	&pass_pages_scanned_attr.attr,
+	&pass_pages_hashed_attr.attr,
+	&pass_pages_merged_attr.attr,
+	&pass_cpu_usecs_attr.attr,
+	&pass_merge_yield_attr.attr,
+	&adaptive_attr.attr,
+	&current_pages_to_scan_attr.attr,
+	&current_sleep_millisecs_attr.attr,
 	NULL,
 };
 
@@ -2092,12 +2401,14 @@ static int __init ksm_init(void)
 		err = PTR_ERR(ksm_thread);
 		goto out_free;
 	}
+	ksmd_thread = ksm_thread;
 
 #ifdef CONFIG_SYSFS
 	err = sysfs_create_group(mm_kobj, &ksm_attr_group);
 	if (err) {
 		printk(KERN_ERR "ksm: register sysfs failed\n");
 		kthread_stop(ksm_thread);
+		ksmd_thread = NULL;
 		goto out_free;
 	}
 #else
@@ -2105,6 +2416,11 @@ static int __init ksm_init(void)
 
 #endif /* CONFIG_SYSFS */
 
+	vmpressure_notifier_register(&ksm_vmpressure_nb);
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&ksm_early_suspend_handler);
+#endif
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 	/*
 	 * Choose a high priority since the callback takes ksm_thread_mutex:
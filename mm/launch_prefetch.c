@@ -0,0 +1,647 @@
+/*
+ * mm/launch_prefetch.c - record and replay the page cache misses of a launch
+ *
+ * App launches fault in scattered pages of APK, ODEX and shared library
+ * files, which ondemand_readahead() cannot predict because they are not
+ * sequential.  They are however very repeatable from one launch of the same
+ * app to the next, so:
+ *
+ *  - in record mode, the major file faults taken by the first process named
+ *    <comm> during its first window_ms milliseconds are logged as (file, page
+ *    index) pairs and turned into a profile of per-file page ranges;
+ *  - the profile can be read back from debugfs, stored by userspace and
+ *    written again after a reboot;
+ *  - in replay mode, the first major fault of each new process named <comm>
+ *    (identified by tgid and start time, so it is replayed once) starts an unbound work item that opens the profile's files and hands
+ *    every range to force_page_cache_readahead(), while the app itself keeps
+ *    running.
+ *
+ * Major faults inside the window are counted in both modes, so the effect
+ * of a profile can be read off "stats".  See
+ * Documentation/vm/launch-prefetch.txt.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/ktime.h>
+#include <linux/sort.h>
+#include <linux/launch_prefetch.h>
+
+#define LP_MAX_RECORDS	8192
+#define LP_MAX_FILES	256
+/* holes up to this many pages are read too, to make larger requests */
+#define LP_MERGE_GAP	4
+
+enum {
+	LP_OFF,
+	LP_RECORD,
+	LP_REPLAY,
+};
+
+static const char * const lp_mode_names[] = {
+	[LP_OFF]	= "off",
+	[LP_RECORD]	= "record",
+	[LP_REPLAY]	= "replay",
+};
+
+struct lp_range {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct lp_file {
+	char *path;
+	struct lp_range *ranges;
+	unsigned int nr_ranges;
+};
+
+struct lp_record {
+	unsigned int file;
+	pgoff_t index;
+};
+
+struct lp_stats {
+	unsigned long record_faults;	/* major faults of the recorded launch */
+	unsigned long record_dropped;	/* faults that did not fit */
+	unsigned long replay_faults;	/* major faults of the last replay */
+	unsigned long replays;
+	unsigned long replay_files;	/* files opened by the last replay */
+	unsigned long replay_missing;	/* files that could not be opened */
+	unsigned long replay_pages;	/* pages requested by the last replay */
+	u64 replay_usecs;		/* duration of the last replay */
+};
+
+/*
+ * lp_mutex protects the mode, the launch window and the record buffers.
+ * lp_profile_mutex protects the profile, which the replay work walks while
+ * the launching app keeps faulting; it nests inside lp_mutex.
+ */
+static DEFINE_MUTEX(lp_mutex);
+static DEFINE_MUTEX(lp_profile_mutex);
+
+static int lp_mode;
+static char lp_comm[TASK_COMM_LEN];
+static u32 lp_window_ms = 3000;
+static pid_t lp_tgid;			/* launch inside its window, or 0 */
+/* the last launch seen, so a running app does not count as a new one */
+static pid_t lp_last_tgid;
+static struct timespec lp_last_start;
+
+static struct lp_record *lp_records;
+static unsigned int lp_nr_records;
+static struct file *lp_rec_files[LP_MAX_FILES];
+static unsigned int lp_nr_rec_files;
+
+static struct lp_file *lp_profile;
+static unsigned int lp_nr_files;
+
+static struct lp_stats lp_stats;
+
+static void lp_window_fn(struct work_struct *work);
+static void lp_replay_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(lp_window_work, lp_window_fn);
+static DECLARE_WORK(lp_replay_work, lp_replay_fn);
+
+static void lp_free_files(struct lp_file *files, unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		kfree(files[i].path);
+		kfree(files[i].ranges);
+	}
+	kfree(files);
+}
+
+/* Replace the profile; called with lp_profile_mutex held. */
+static void lp_set_profile(struct lp_file *files, unsigned int nr)
+{
+	lp_free_files(lp_profile, lp_nr_files);
+	lp_profile = files;
+	lp_nr_files = nr;
+}
+
+static void lp_drop_records(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < lp_nr_rec_files; i++)
+		fput(lp_rec_files[i]);
+	lp_nr_rec_files = 0;
+	lp_nr_records = 0;
+}
+
+static int lp_add_range(struct lp_file *lpf, pgoff_t start, unsigned long nr)
+{
+	struct lp_range *ranges;
+
+	ranges = krealloc(lpf->ranges, (lpf->nr_ranges + 1) * sizeof(*ranges),
+			  GFP_KERNEL);
+	if (!ranges)
+		return -ENOMEM;
+	ranges[lpf->nr_ranges].start = start;
+	ranges[lpf->nr_ranges].nr = nr;
+	lpf->ranges = ranges;
+	lpf->nr_ranges++;
+	return 0;
+}
+
+static int lp_cmp_index(const void *a, const void *b)
+{
+	pgoff_t x = *(const pgoff_t *)a, y = *(const pgoff_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Turn the records of one file into sorted page ranges, merging
+ * neighbours that are at most LP_MERGE_GAP pages apart.
+ */
+static int lp_build_ranges(struct lp_file *lpf, unsigned int file,
+			   pgoff_t *idx)
+{
+	unsigned int i, n = 0;
+	pgoff_t start, end;
+	int err;
+
+	for (i = 0; i < lp_nr_records; i++)
+		if (lp_records[i].file == file)
+			idx[n++] = lp_records[i].index;
+	if (!n)
+		return 0;
+	sort(idx, n, sizeof(*idx), lp_cmp_index, NULL);
+
+	start = end = idx[0];
+	for (i = 1; i < n; i++) {
+		if (idx[i] <= end + LP_MERGE_GAP + 1) {
+			end = max(end, idx[i]);
+			continue;
+		}
+		err = lp_add_range(lpf, start, end - start + 1);
+		if (err)
+			return err;
+		start = end = idx[i];
+	}
+	return lp_add_range(lpf, start, end - start + 1);
+}
+
+/* Convert the records into the profile; called with lp_mutex held. */
+static void lp_finish_record(void)
+{
+	struct lp_file *files;
+	pgoff_t *idx;
+	char *buf, *path;
+	unsigned int i, nr = 0;
+
+	files = kcalloc(lp_nr_rec_files ? : 1, sizeof(*files), GFP_KERNEL);
+	idx = vmalloc(LP_MAX_RECORDS * sizeof(*idx));
+	buf = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!files || !idx || !buf)
+		goto out;
+
+	for (i = 0; i < lp_nr_rec_files; i++) {
+		path = d_path(&lp_rec_files[i]->f_path, buf, PATH_MAX);
+		if (IS_ERR(path))
+			continue;
+		files[nr].path = kstrdup(path, GFP_KERNEL);
+		if (!files[nr].path || lp_build_ranges(&files[nr], i, idx)) {
+			lp_free_files(files, nr + 1);
+			files = NULL;
+			goto out;
+		}
+		nr++;
+	}
+
+	mutex_lock(&lp_profile_mutex);
+	lp_set_profile(files, nr);
+	mutex_unlock(&lp_profile_mutex);
+	files = NULL;
+out:
+	kfree(files);
+	kfree(buf);
+	vfree(idx);
+	lp_drop_records();
+}
+
+static void lp_window_fn(struct work_struct *work)
+{
+	mutex_lock(&lp_mutex);
+	if (!lp_tgid)
+		goto out;
+	if (lp_mode == LP_RECORD) {
+		lp_finish_record();
+		vfree(lp_records);
+		lp_records = NULL;
+		lp_mode = LP_OFF;
+	}
+	lp_tgid = 0;
+out:
+	mutex_unlock(&lp_mutex);
+}
+
+static void lp_replay_fn(struct work_struct *work)
+{
+	ktime_t start = ktime_get();
+	unsigned long files = 0, missing = 0, pages = 0;
+	struct address_space *mapping;
+	struct file *filp;
+	unsigned int i, j;
+
+	mutex_lock(&lp_profile_mutex);
+	for (i = 0; i < lp_nr_files; i++) {
+		filp = filp_open(lp_profile[i].path, O_RDONLY | O_LARGEFILE, 0);
+		if (IS_ERR(filp)) {
+			missing++;
+			continue;
+		}
+		mapping = filp->f_mapping;
+		if (mapping->a_ops && mapping->a_ops->readpage) {
+			for (j = 0; j < lp_profile[i].nr_ranges; j++) {
+				force_page_cache_readahead(mapping, filp,
+						lp_profile[i].ranges[j].start,
+						lp_profile[i].ranges[j].nr);
+				pages += lp_profile[i].ranges[j].nr;
+			}
+		}
+		filp_close(filp, NULL);
+		files++;
+	}
+	mutex_unlock(&lp_profile_mutex);
+
+	mutex_lock(&lp_mutex);
+	lp_stats.replay_files = files;
+	lp_stats.replay_missing = missing;
+	lp_stats.replay_pages = pages;
+	lp_stats.replay_usecs = ktime_to_us(ktime_sub(ktime_get(), start));
+	mutex_unlock(&lp_mutex);
+}
+
+static void lp_record_fault(struct file *file, pgoff_t index)
+{
+	unsigned int i;
+
+	for (i = 0; i < lp_nr_rec_files; i++)
+		if (lp_rec_files[i]->f_mapping == file->f_mapping)
+			break;
+
+	if (i == lp_nr_rec_files) {
+		if (i == LP_MAX_FILES)
+			goto drop;
+		get_file(file);
+		lp_rec_files[lp_nr_rec_files++] = file;
+	}
+	if (lp_nr_records == LP_MAX_RECORDS)
+		goto drop;
+
+	lp_records[lp_nr_records].file = i;
+	lp_records[lp_nr_records].index = index;
+	lp_nr_records++;
+	lp_stats.record_faults++;
+	return;
+drop:
+	lp_stats.record_dropped++;
+}
+
+/**
+ * launch_prefetch_fault - note a major fault on a file page
+ * @file:	file being faulted on
+ * @index:	page index within @file
+ *
+ * Called from filemap_fault() when the page was not in the page cache.
+ */
+void launch_prefetch_fault(struct file *file, pgoff_t index)
+{
+	if (likely(!ACCESS_ONCE(lp_mode)))
+		return;
+	if (strncmp(current->group_leader->comm, lp_comm, TASK_COMM_LEN))
+		return;
+
+	mutex_lock(&lp_mutex);
+	if (lp_mode == LP_OFF)
+		goto out;
+
+	if (!lp_tgid) {
+		struct task_struct *leader = current->group_leader;
+
+		/* faults after the window of an already seen launch */
+		if (lp_last_tgid == current->tgid &&
+		    timespec_equal(&lp_last_start, &leader->start_time))
+			goto out;
+
+		/* a new launch: open its window */
+		lp_tgid = current->tgid;
+		lp_last_tgid = current->tgid;
+		lp_last_start = leader->start_time;
+		if (lp_mode == LP_REPLAY) {
+			lp_stats.replay_faults = 0;
+			lp_stats.replays++;
+			queue_work(system_unbound_wq, &lp_replay_work);
+		}
+		schedule_delayed_work(&lp_window_work,
+				      msecs_to_jiffies(lp_window_ms));
+	} else if (lp_tgid != current->tgid) {
+		goto out;
+	}
+
+	if (lp_mode == LP_RECORD)
+		lp_record_fault(file, index);
+	else
+		lp_stats.replay_faults++;
+out:
+	mutex_unlock(&lp_mutex);
+}
+
+/* Stop recording or replaying; called with lp_mutex held. */
+static void lp_stop(void)
+{
+	lp_mode = LP_OFF;
+	lp_tgid = 0;
+	lp_last_tgid = 0;
+	lp_drop_records();
+	vfree(lp_records);
+	lp_records = NULL;
+}
+
+/*
+ * control: "record <comm>", "replay" or "off".
+ */
+static ssize_t lp_control_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	char buf[TASK_COMM_LEN + 16], *arg;
+	int err = 0;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	arg = strim(buf);
+
+	/* the window work takes lp_mutex, so cancel it first */
+	cancel_delayed_work_sync(&lp_window_work);
+
+	mutex_lock(&lp_mutex);
+	if (!strncmp(arg, "record ", 7)) {
+		lp_stop();
+		lp_records = vmalloc(LP_MAX_RECORDS * sizeof(*lp_records));
+		if (!lp_records) {
+			err = -ENOMEM;
+			goto out;
+		}
+		strlcpy(lp_comm, skip_spaces(arg + 7), sizeof(lp_comm));
+		lp_stats.record_faults = 0;
+		lp_stats.record_dropped = 0;
+		lp_mode = LP_RECORD;
+	} else if (!strcmp(arg, "replay")) {
+		lp_stop();
+		if (!lp_comm[0] || !lp_nr_files) {
+			err = -ENOENT;
+			goto out;
+		}
+		lp_mode = LP_REPLAY;
+	} else if (!strcmp(arg, "off")) {
+		lp_stop();
+	} else {
+		err = -EINVAL;
+	}
+out:
+	mutex_unlock(&lp_mutex);
+	return err ? err : count;
+}
+
+static ssize_t lp_control_read(struct file *file, char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	char buf[TASK_COMM_LEN + 16];
+	int len;
+
+	mutex_lock(&lp_mutex);
+	len = scnprintf(buf, sizeof(buf), "%s %s\n",
+			lp_mode_names[lp_mode], lp_comm);
+	mutex_unlock(&lp_mutex);
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+static const struct file_operations lp_control_fops = {
+	.read		= lp_control_read,
+	.write		= lp_control_write,
+	.llseek		= default_llseek,
+};
+
+/*
+ * profile: a text dump of the page ranges, one file at a time:
+ *
+ *	comm <name>
+ *	file <path>
+ *	<first page> <nr pages>
+ *	...
+ *
+ * Writing the same text back loads it as the current profile.
+ */
+static int lp_profile_show(struct seq_file *m, void *v)
+{
+	unsigned int i, j;
+
+	mutex_lock(&lp_profile_mutex);
+	seq_printf(m, "comm %s\n", lp_comm);
+	for (i = 0; i < lp_nr_files; i++) {
+		seq_printf(m, "file %s\n", lp_profile[i].path);
+		for (j = 0; j < lp_profile[i].nr_ranges; j++)
+			seq_printf(m, "%lu %lu\n",
+				   lp_profile[i].ranges[j].start,
+				   lp_profile[i].ranges[j].nr);
+	}
+	mutex_unlock(&lp_profile_mutex);
+	return 0;
+}
+
+struct lp_parser {
+	char comm[TASK_COMM_LEN];
+	struct lp_file *files;
+	unsigned int nr_files;
+	int error;
+	size_t len;
+	char line[PATH_MAX + 8];
+};
+
+static int lp_parse_line(struct lp_parser *p, char *line)
+{
+	struct lp_file *files;
+	unsigned long start, nr;
+
+	line = strim(line);
+	if (!*line)
+		return 0;
+
+	if (!strncmp(line, "comm ", 5)) {
+		strlcpy(p->comm, skip_spaces(line + 5), sizeof(p->comm));
+		return 0;
+	}
+
+	if (!strncmp(line, "file ", 5)) {
+		if (p->nr_files == LP_MAX_FILES)
+			return -E2BIG;
+		files = krealloc(p->files, (p->nr_files + 1) * sizeof(*files),
+				 GFP_KERNEL);
+		if (!files)
+			return -ENOMEM;
+		p->files = files;
+		memset(&files[p->nr_files], 0, sizeof(*files));
+		files[p->nr_files].path = kstrdup(skip_spaces(line + 5),
+						  GFP_KERNEL);
+		if (!files[p->nr_files].path)
+			return -ENOMEM;
+		p->nr_files++;
+		return 0;
+	}
+
+	if (!p->nr_files || sscanf(line, "%lu %lu", &start, &nr) != 2 || !nr)
+		return -EINVAL;
+	return lp_add_range(&p->files[p->nr_files - 1], start, nr);
+}
+
+static ssize_t lp_profile_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct lp_parser *p = m->private;
+	size_t done = 0, n;
+	char *nl;
+
+	if (p->error)
+		return p->error;
+
+	while (done < count) {
+		n = min(count - done, sizeof(p->line) - 1 - p->len);
+		if (!n) {
+			p->error = -ENAMETOOLONG;
+			return p->error;
+		}
+		if (copy_from_user(p->line + p->len, ubuf + done, n))
+			return -EFAULT;
+		p->len += n;
+		p->line[p->len] = '\0';
+		done += n;
+
+		while ((nl = strchr(p->line, '\n'))) {
+			*nl = '\0';
+			p->error = lp_parse_line(p, p->line);
+			if (p->error)
+				return p->error;
+			p->len -= nl + 1 - p->line;
+			memmove(p->line, nl + 1, p->len + 1);
+		}
+	}
+	return count;
+}
+
+static int lp_profile_open(struct inode *inode, struct file *file)
+{
+	struct lp_parser *p = NULL;
+	int err;
+
+	if (file->f_mode & FMODE_WRITE) {
+		p = kzalloc(sizeof(*p), GFP_KERNEL);
+		if (!p)
+			return -ENOMEM;
+	}
+	err = single_open(file, lp_profile_show, p);
+	if (err)
+		kfree(p);
+	return err;
+}
+
+static int lp_profile_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *m = file->private_data;
+	struct lp_parser *p = m->private;
+
+	if (p) {
+		if (!p->error && p->len)
+			p->error = lp_parse_line(p, p->line);
+		if (!p->error && p->comm[0] && p->nr_files) {
+			mutex_lock(&lp_mutex);
+			if (lp_mode == LP_RECORD)
+				lp_stop();
+			strlcpy(lp_comm, p->comm, sizeof(lp_comm));
+			mutex_lock(&lp_profile_mutex);
+			lp_set_profile(p->files, p->nr_files);
+			mutex_unlock(&lp_profile_mutex);
+			mutex_unlock(&lp_mutex);
+		} else {
+			lp_free_files(p->files, p->nr_files);
+		}
+		kfree(p);
+	}
+	return single_release(inode, file);
+}
+
+static const struct file_operations lp_profile_fops = {
+	.open		= lp_profile_open,
+	.read		= seq_read,
+	.write		= lp_profile_write,
+	.llseek		= seq_lseek,
+	.release	= lp_profile_release,
+};
+
+static int lp_stats_show(struct seq_file *m, void *v)
+{
+	mutex_lock(&lp_mutex);
+	seq_printf(m, "record_faults %lu\n", lp_stats.record_faults);
+	seq_printf(m, "record_dropped %lu\n", lp_stats.record_dropped);
+	seq_printf(m, "replays %lu\n", lp_stats.replays);
+	seq_printf(m, "replay_faults %lu\n", lp_stats.replay_faults);
+	seq_printf(m, "replay_files %lu\n", lp_stats.replay_files);
+	seq_printf(m, "replay_missing %lu\n", lp_stats.replay_missing);
+	seq_printf(m, "replay_pages %lu\n", lp_stats.replay_pages);
+	seq_printf(m, "replay_usecs %llu\n", lp_stats.replay_usecs);
+	mutex_unlock(&lp_mutex);
+	return 0;
+}
+
+static int lp_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lp_stats_show, NULL);
+}
+
+static const struct file_operations lp_stats_fops = {
+	.open		= lp_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init launch_prefetch_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("launch_prefetch", NULL);
+	if (!root)
+		return -ENXIO;
+
+	debugfs_create_file("control", S_IRUSR | S_IWUSR, root, NULL,
+			    &lp_control_fops);
+	debugfs_create_file("profile", S_IRUSR | S_IWUSR, root, NULL,
+			    &lp_profile_fops);
+	debugfs_create_file("stats", S_IRUSR, root, NULL, &lp_stats_fops);
+	debugfs_create_u32("window_ms", S_IRUSR | S_IWUSR, root,
+			   &lp_window_ms);
+	return 0;
+}
+late_initcall(launch_prefetch_init);
@@ -186,6 +186,7 @@ struct zpool *zpool_create_pool(char *type, gfp_t gfp, struct zpool_ops *ops)
 
 	return zpool;
 }
+EXPORT_SYMBOL(zpool_create_pool);
 
 /**
  * zpool_destroy_pool() - Destroy a zpool
@@ -209,6 +210,7 @@ void zpool_destroy_pool(struct zpool *zpool)
 	zpool_put_driver(zpool->driver);
 	kfree(zpool);
 }
+EXPORT_SYMBOL(zpool_destroy_pool);
 
 /**
  * zpool_get_type() - Get the type of the zpool
@@ -224,6 +226,7 @@ char *zpool_get_type(struct zpool *zpool)
 {
 	return zpool->type;
 }
+EXPORT_SYMBOL(zpool_get_type);
 
 /**
  * zpool_malloc() - Allocate memory
@@ -246,6 +249,7 @@ int zpool_malloc(struct zpool *zpool, size_t size, gfp_t gfp,
 {
 	return zpool->driver->malloc(zpool->pool, size, gfp, handle);
 }
+EXPORT_SYMBOL(zpool_malloc);
 
 /**
  * zpool_free() - Free previously allocated memory
@@ -265,6 +269,7 @@ void zpool_free(struct zpool *zpool, unsigned long handle)
 {
 	zpool->driver->free(zpool->pool, handle);
 }
+EXPORT_SYMBOL(zpool_free);
 
 /**
  * zpool_shrink() - Shrink the pool size
@@ -288,6 +293,7 @@ int zpool_shrink(struct zpool *zpool, unsigned int pages,
 {
 	return zpool->driver->shrink(zpool->pool, pages, reclaimed);
 }
+EXPORT_SYMBOL(zpool_shrink);
 
 /**
  * zpool_map_handle() - Map a previously allocated handle into memory
@@ -316,6 +322,7 @@ void *zpool_map_handle(struct zpool *zpool, unsigned long handle,
 {
 	return zpool->driver->map(zpool->pool, handle, mapmode);
 }
+EXPORT_SYMBOL(zpool_map_handle);
 
 /**
  * zpool_unmap_handle() - Unmap a previously mapped handle
@@ -331,6 +338,7 @@ void zpool_unmap_handle(struct zpool *zpool, unsigned long handle)
 {
 	zpool->driver->unmap(zpool->pool, handle);
 }
+EXPORT_SYMBOL(zpool_unmap_handle);
 
 /**
  * zpool_get_total_size() - The total size of the pool
@@ -344,6 +352,7 @@ u64 zpool_get_total_size(struct zpool *zpool)
 {
 	return zpool->driver->total_size(zpool->pool);
 }
+EXPORT_SYMBOL(zpool_get_total_size);
 
 static int __init init_zpool(void)
 {
@@ -0,0 +1,161 @@
+/*
+ * zpool allocator benchmark
+ *
+ * Pushes a synthetic stream of compressed-page sized objects through each
+ * zpool driver and reports how densely they were stored and how long the
+ * average malloc and free took.  The object sizes are drawn from a fixed
+ * pseudo-random sequence, so runs against different drivers see exactly the
+ * same workload.
+ *
+ * Usage: insmod zpool_bench.ko [nr_objects=N] [min_size=B] [max_size=B]
+ *
+ * The module always fails to load once the results have been printed, so it
+ * can be run repeatedly without an rmmod in between.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/zpool.h>
+
+static unsigned int nr_objects = 16384;
+module_param(nr_objects, uint, 0444);
+MODULE_PARM_DESC(nr_objects, "Number of objects allocated per driver");
+
+/* lzo typically shrinks an anonymous page to somewhere in this range */
+static unsigned int min_size = 256;
+module_param(min_size, uint, 0444);
+MODULE_PARM_DESC(min_size, "Smallest object size in bytes");
+
+static unsigned int max_size = 3 * PAGE_SIZE / 4;
+module_param(max_size, uint, 0444);
+MODULE_PARM_DESC(max_size, "Largest object size in bytes");
+
+static char *drivers[] = { "zbud", "zsmalloc" };
+
+static unsigned int *sizes;
+static unsigned long *handles;
+
+/* small LCG so every run and every driver sees the same sequence */
+static unsigned int bench_next(unsigned int *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static void bench_fill_sizes(void)
+{
+	unsigned int seed = 1, i;
+
+	for (i = 0; i < nr_objects; i++)
+		sizes[i] = min_size + bench_next(&seed) %
+				(max_size - min_size + 1);
+}
+
+static void bench_driver(char *type)
+{
+	struct zpool *pool;
+	u64 stored = 0, pool_size;
+	u64 alloc_ns = 0, free_ns = 0;
+	unsigned int i, j, nr = 0, seed = 2;
+	ktime_t start;
+	void *dst;
+
+	pool = zpool_create_pool(type, GFP_KERNEL, NULL);
+	if (!pool) {
+		pr_info("%s: not available\n", type);
+		return;
+	}
+
+	for (i = 0; i < nr_objects; i++) {
+		start = ktime_get();
+		if (zpool_malloc(pool, sizes[i], __GFP_NORETRY | __GFP_NOWARN,
+				&handles[i]))
+			break;
+		alloc_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		dst = zpool_map_handle(pool, handles[i], ZPOOL_MM_WO);
+		memset(dst, i, sizes[i]);
+		zpool_unmap_handle(pool, handles[i]);
+
+		stored += sizes[i];
+		nr++;
+		cond_resched();
+	}
+	pool_size = zpool_get_total_size(pool);
+
+	/* shuffle the free order so pages empty out unevenly */
+	for (i = nr; i > 1; i--) {
+		unsigned long tmp;
+
+		j = bench_next(&seed) % i;
+		tmp = handles[i - 1];
+		handles[i - 1] = handles[j];
+		handles[j] = tmp;
+	}
+
+	for (i = 0; i < nr; i++) {
+		start = ktime_get();
+		zpool_free(pool, handles[i]);
+		free_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+		cond_resched();
+	}
+
+	zpool_destroy_pool(pool);
+
+	if (!nr) {
+		pr_info("%s: no allocation succeeded\n", type);
+		return;
+	}
+	do_div(alloc_ns, nr);
+	do_div(free_ns, nr);
+
+	pr_info("%s: %u objects, %llu bytes stored in %llu bytes of pool, "
+		"density %llu%%\n", type, nr, stored, pool_size,
+		pool_size ? div64_u64(stored * 100, pool_size) : 0);
+	pr_info("%s: avg alloc %llu ns, avg free %llu ns\n",
+		type, alloc_ns, free_ns);
+}
+
+static int __init zpool_bench_init(void)
+{
+	int i;
+
+	if (!nr_objects || min_size == 0 || min_size > max_size ||
+	    max_size > PAGE_SIZE)
+		return -EINVAL;
+
+	sizes = vmalloc(nr_objects * sizeof(*sizes));
+	handles = vmalloc(nr_objects * sizeof(*handles));
+	if (!sizes || !handles) {
+		vfree(sizes);
+		vfree(handles);
+		return -ENOMEM;
+	}
+
+	bench_fill_sizes();
+	for (i = 0; i < ARRAY_SIZE(drivers); i++)
+		bench_driver(drivers[i]);
+
+	vfree(sizes);
+	vfree(handles);
+
+	return -EAGAIN;
+}
+
+module_init(zpool_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("zpool allocator density and latency benchmark");
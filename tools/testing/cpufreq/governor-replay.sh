@@ -0,0 +1,67 @@
+#!/bin/sh
+#
+# governor-replay.sh - replay a load trace through several cpufreq governors
+# and print the cpufreq_replay results for each.
+#
+#	governor-replay.sh [-t gov/tunable=value]... trace [governor...]
+#
+# Governors default to "ondemand interactive intelliactive conservative".
+# Each -t option is written to /sys/devices/system/cpu/cpufreq/<gov>/<tunable>
+# after <gov> is selected, e.g. -t interactive/timer_rate=10000.
+#
+# Under QEMU, or anywhere without a cpufreq driver, load cpufreq_sim first:
+#
+#	modprobe cpufreq_sim
+#	modprobe cpufreq_replay
+#	governor-replay.sh traces/step.trace
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation.
+
+CPUFREQ=/sys/devices/system/cpu
+REPLAY=/sys/kernel/debug/cpufreq_replay
+tunables=
+
+usage() {
+	echo "usage: $0 [-t gov/tunable=value]... trace [governor...]" >&2
+	exit 1
+}
+
+while getopts t: opt; do
+	case $opt in
+	t)	tunables="$tunables $OPTARG" ;;
+	*)	usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -ge 1 ] || usage
+trace=$1
+shift
+governors=${*:-"ondemand interactive intelliactive conservative"}
+
+if [ ! -d $REPLAY ]; then
+	mount -t debugfs none /sys/kernel/debug 2>/dev/null
+	[ -d $REPLAY ] || { echo "$0: cpufreq_replay not loaded" >&2; exit 1; }
+fi
+
+for gov in $governors; do
+	for cpu in $CPUFREQ/cpu[0-9]*; do
+		[ -w $cpu/cpufreq/scaling_governor ] || continue
+		echo $gov > $cpu/cpufreq/scaling_governor || exit 1
+	done
+
+	for t in $tunables; do
+		case $t in
+		$gov/*)	echo ${t#*=} > $CPUFREQ/cpufreq/${t%%=*} || exit 1 ;;
+		esac
+	done
+
+	cat $trace > $REPLAY/trace || exit 1
+	echo 1 > $REPLAY/run || exit 1
+	while [ "$(cat $REPLAY/results)" = running ]; do
+		sleep 1
+	done
+	cat $REPLAY/results
+	echo
+done
@@ -0,0 +1,257 @@
+/*
+ * wakeup-latency.c - measure wakeup latency of a foreground thread while
+ * background threads keep the cpus busy.
+ *
+ * Two foreground threads ping-pong over a pair of pipes, and a third sleeps
+ * on an absolute timer; every wakeup records how late the thread got to
+ * run.  Background threads alternate between spinning and sleeping like
+ * sync or download tasks.  Threads are moved into the cpu cgroups given
+ * with -f and -b, so the effect of cpu.wake_hint can be compared by running
+ * the test with the hint set and cleared:
+ *
+ *	echo 1 > /dev/cpuctl/cpu.wake_hint
+ *	echo 2 > /dev/cpuctl/bg_non_interactive/cpu.wake_hint
+ *	wakeup-latency -f /dev/cpuctl -b /dev/cpuctl/bg_non_interactive
+ *
+ * Build with: gcc -O2 -pthread -o wakeup-latency wakeup-latency.c -lrt
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+static const char *fg_cgroup;
+static const char *bg_cgroup;
+static int nr_bg = 2;
+static int iterations = 2000;
+static long period_us = 4000;
+static long bg_busy_us = 6000, bg_sleep_us = 4000;
+static volatile int stop;
+
+struct samples {
+	const char *name;
+	long *lat;
+	int nr;
+};
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void join_cgroup(const char *dir)
+{
+	char path[256], buf[32];
+	int fd, len;
+
+	if (!dir)
+		return;
+	snprintf(path, sizeof(path), "%s/tasks", dir);
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	len = snprintf(buf, sizeof(buf), "%ld", (long)syscall(SYS_gettid));
+	if (write(fd, buf, len) != len) {
+		perror(path);
+		exit(1);
+	}
+	close(fd);
+}
+
+static void show_wake_stats(const char *dir, const char *when)
+{
+	char path[256], buf[256];
+	FILE *f;
+
+	if (!dir)
+		return;
+	snprintf(path, sizeof(path), "%s/cpu.wake_stats", dir);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	printf("%s %s:\n", dir, when);
+	while (fgets(buf, sizeof(buf), f))
+		printf("  %s", buf);
+	fclose(f);
+}
+
+static void *bg_thread(void *arg)
+{
+	struct timespec ts = { 0, bg_sleep_us * 1000 };
+	long long end;
+
+	join_cgroup(bg_cgroup);
+	while (!stop) {
+		end = now_ns() + bg_busy_us * 1000LL;
+		while (now_ns() < end)
+			;
+		nanosleep(&ts, NULL);
+	}
+	return NULL;
+}
+
+static int ping[2], pong[2];
+
+/* ponger: woken through the pipe, measures how long the wakeup took */
+static void *pong_thread(void *arg)
+{
+	struct samples *s = arg;
+	long long sent;
+
+	join_cgroup(fg_cgroup);
+	while (s->nr < iterations) {
+		if (read(ping[0], &sent, sizeof(sent)) != sizeof(sent))
+			break;
+		s->lat[s->nr++] = (now_ns() - sent) / 1000;
+		if (write(pong[1], &sent, sizeof(sent)) != sizeof(sent))
+			break;
+	}
+	return NULL;
+}
+
+static void *ping_thread(void *arg)
+{
+	struct timespec ts = { 0, period_us * 1000 };
+	long long t;
+	int i;
+
+	join_cgroup(fg_cgroup);
+	for (i = 0; i < iterations; i++) {
+		nanosleep(&ts, NULL);
+		t = now_ns();
+		if (write(ping[1], &t, sizeof(t)) != sizeof(t) ||
+		    read(pong[0], &t, sizeof(t)) != sizeof(t))
+			break;
+	}
+	return NULL;
+}
+
+/* timer: sleeps until an absolute deadline, measures how late it ran */
+static void *timer_thread(void *arg)
+{
+	struct samples *s = arg;
+	struct timespec ts;
+	long long deadline;
+
+	join_cgroup(fg_cgroup);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	while (s->nr < iterations) {
+		ts.tv_nsec += period_us * 1000;
+		while (ts.tv_nsec >= 1000000000) {
+			ts.tv_nsec -= 1000000000;
+			ts.tv_sec++;
+		}
+		deadline = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		s->lat[s->nr++] = (now_ns() - deadline) / 1000;
+	}
+	return NULL;
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+	long x = *(const long *)a, y = *(const long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(struct samples *s)
+{
+	long long sum = 0;
+	int i;
+
+	if (!s->nr)
+		return;
+	qsort(s->lat, s->nr, sizeof(long), cmp_long);
+	for (i = 0; i < s->nr; i++)
+		sum += s->lat[i];
+	printf("%-6s n=%d min=%ld avg=%lld p50=%ld p90=%ld p99=%ld max=%ld (us)\n",
+	       s->name, s->nr, s->lat[0], sum / s->nr, s->lat[s->nr / 2],
+	       s->lat[s->nr * 90 / 100], s->lat[s->nr * 99 / 100],
+	       s->lat[s->nr - 1]);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-f fg_cgroup] [-b bg_cgroup] [-n bg_threads]\n"
+		"          [-i iterations] [-p period_us]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct samples pipe_s = { "pipe" }, timer_s = { "timer" };
+	pthread_t bg[64], tping, tpong, ttimer;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "f:b:n:i:p:")) != -1) {
+		switch (opt) {
+		case 'f':
+			fg_cgroup = optarg;
+			break;
+		case 'b':
+			bg_cgroup = optarg;
+			break;
+		case 'n':
+			nr_bg = atoi(optarg);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'p':
+			period_us = atol(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nr_bg < 0 || nr_bg > 64 || iterations <= 0 || period_us <= 0)
+		usage(argv[0]);
+
+	pipe_s.lat = calloc(iterations, sizeof(long));
+	timer_s.lat = calloc(iterations, sizeof(long));
+	if (!pipe_s.lat || !timer_s.lat || pipe(ping) || pipe(pong)) {
+		perror("setup");
+		return 1;
+	}
+
+	show_wake_stats(fg_cgroup, "before");
+	show_wake_stats(bg_cgroup, "before");
+
+	for (i = 0; i < nr_bg; i++)
+		pthread_create(&bg[i], NULL, bg_thread, NULL);
+	pthread_create(&tpong, NULL, pong_thread, &pipe_s);
+	pthread_create(&tping, NULL, ping_thread, NULL);
+	pthread_create(&ttimer, NULL, timer_thread, &timer_s);
+
+	pthread_join(tping, NULL);
+	pthread_join(tpong, NULL);
+	pthread_join(ttimer, NULL);
+	stop = 1;
+	for (i = 0; i < nr_bg; i++)
+		pthread_join(bg[i], NULL);
+
+	report(&pipe_s);
+	report(&timer_s);
+
+	show_wake_stats(fg_cgroup, "after");
+	show_wake_stats(bg_cgroup, "after");
+	return 0;
+}
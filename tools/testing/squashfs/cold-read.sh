@@ -0,0 +1,77 @@
+#!/bin/sh
+#
+# Measure squashfs cold-read throughput for each compressor.
+#
+# Usage: cold-read.sh <source-dir> [readers] [codecs...]
+#
+# An image of <source-dir> is built with mksquashfs for every codec
+# (default: gzip lzo lz4 xz), loop-mounted, and read back with the page
+# cache dropped before every run.  With more than one reader, the files
+# are split between parallel readers, which exercises the per-cpu
+# decompressors (CONFIG_SQUASHFS_DECOMP_MULTI_PERCPU).
+#
+# Needs root, a squashfs-tools recent enough for -comp lz4, and a
+# kernel with the matching CONFIG_SQUASHFS_* codecs enabled.
+
+SRC=$1
+READERS=${2:-1}
+[ $# -gt 2 ] && shift 2 && CODECS="$*"
+CODECS=${CODECS:-"gzip lzo lz4 xz"}
+
+if [ -z "$SRC" ] || [ ! -d "$SRC" ]; then
+	echo "usage: $0 <source-dir> [readers] [codecs...]" >&2
+	exit 1
+fi
+
+TMP=$(mktemp -d /tmp/sqfs-bench.XXXXXX) || exit 1
+MNT=$TMP/mnt
+mkdir $MNT
+trap 'umount $MNT 2>/dev/null; rm -rf $TMP' EXIT
+
+now_ns() {
+	date +%s%N
+}
+
+cold_read() {
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+
+	find $MNT -type f > $TMP/files
+	split -n r/$READERS $TMP/files $TMP/part.
+
+	start=$(now_ns)
+	for part in $TMP/part.*; do
+		xargs -a $part -d '\n' cat > /dev/null &
+	done
+	wait
+	end=$(now_ns)
+
+	rm -f $TMP/part.*
+	echo $(( (end - start) / 1000 ))
+}
+
+bytes=$(du -sb "$SRC" | cut -f1)
+printf "%-6s %12s %12s %10s\n" codec image_KB time_us MB/s
+
+for codec in $CODECS; do
+	img=$TMP/$codec.img
+	if ! mksquashfs "$SRC" $img -comp $codec -noappend \
+			> /dev/null 2>&1; then
+		echo "$codec: mksquashfs failed, skipping" >&2
+		continue
+	fi
+	if ! mount -t squashfs -o loop,ro $img $MNT; then
+		echo "$codec: mount failed, skipping" >&2
+		rm -f $img
+		continue
+	fi
+
+	us=$(cold_read)
+	[ $us -gt 0 ] || us=1
+	printf "%-6s %12d %12d %10d\n" $codec \
+		$(( $(stat -c %s $img) / 1024 )) $us \
+		$(( bytes / us ))
+
+	umount $MNT
+	rm -f $img
+done